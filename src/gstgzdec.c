@@ -62,19 +62,71 @@
 
 #include <gst/gst.h>
 #include "gstgzdec.h"
-
-#include <zlib.h>
-#include <bzlib.h>
+#include "gstgzdeclazy.h"
+#include "gstgzdecmemfd.h"
+#include "gstgzdecpool.h"
+#include "gstgzdecsrc.h"
+#include "gsttardemux.h"
+#include "gstzipdemux.h"
+#include "gzdeccore.h"
+#include "gzdeccrc.h"
+#include "gzdecdigest.h"
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 GST_DEBUG_CATEGORY_STATIC(gst_gzdec_debug);
 #define GST_CAT_DEFAULT gst_gzdec_debug
 #define DEFAULT_DEC_SIZE 1024
+#define DEFAULT_METHOD AUTO
+#define DEFAULT_THREADS 1
+#define DEFAULT_MAX_IN_FLIGHT 16
+#define DEFAULT_PRIORITY 1
+#define DEFAULT_VERIFY VERIFY_CRC32
+#define DEFAULT_LATENCY_MODE LATENCY_THROUGHPUT
+#define DEFAULT_MAX_DELAY (10 * GST_MSECOND)
+#define DEFAULT_DIGEST DIGEST_NONE
+#define DEFAULT_ALIGN ALIGN_NONE
+#define DEFAULT_DELIMITER 0
+#define DEFAULT_RECORD_SIZE 512
+#define DEFAULT_MAX_OUTPUT_BYTES 0
+#define DEFAULT_MAX_RATIO 0
+#define DEFAULT_MAX_RATE 0
+/* max-ratio only applies past this much output, so a highly compressible
+ * start of a file is not taken for a bomb */
+#define MAX_RATIO_MIN_OUTPUT (1024 * 1024)
+#define DEFAULT_ALLOCATOR ALLOCATOR_SYSTEM
+/* stream mode output size with a memfd allocator, one huge page */
+#define MEMFD_DEC_SIZE (2 * 1024 * 1024)
+/* low-latency mode coalesces output into buffers of up to this size */
+#define LOW_LATENCY_BUFFER_SIZE 65536
+/* compressed bytes handed to the core per iteration, flushing is checked
+ * between iterations */
+#define MAX_ITERATION_INPUT (256 * 1024)
 
 enum
 {
   PROP_0,
   PROP_SILENT,
-  PROP_METHOD
+  PROP_METHOD,
+  PROP_FRAMING,
+  PROP_THREADS,
+  PROP_MAX_IN_FLIGHT,
+  PROP_VERIFY,
+  PROP_LATENCY_MODE,
+  PROP_MAX_DELAY,
+  PROP_PRIORITY,
+  PROP_MAX_THREADS,
+  PROP_DIGEST,
+  PROP_ALIGN,
+  PROP_DELIMITER,
+  PROP_RECORD_SIZE,
+  PROP_ALLOCATOR,
+  PROP_MAX_OUTPUT_BYTES,
+  PROP_MAX_RATIO,
+  PROP_MAX_RATE
 };
 
 struct _GstGzdec
@@ -85,9 +137,75 @@ struct _GstGzdec
 
   gboolean silent;
   GstDecMethod method;
+  GstDecFraming framing;
+  GstDecVerify verify;
   gboolean ready;
-  z_stream stream;
-  bz_stream bz_stream;
+  GzdecCore *core;
+
+  /* 64-bit byte positions in the compressed input and decoded output */
+  guint64 in_offset;
+  guint64 out_offset;
+  /* set from FLUSH_START until FLUSH_STOP, leftover is the compressed input
+   * a flush interrupted, it is decoded first by the next chain call */
+  gint flushing;
+  GstBuffer *leftover;
+  /* decoded size announced by the gzip trailer, 0 if unknown */
+  guint64 duration;
+
+  /* concurrent per-buffer decoding on the shared pool, jobs are queued in
+   * input order */
+  guint threads;
+  guint max_in_flight;
+  guint priority;
+  GzdecPoolClient *client;
+  GQueue jobs;
+  GMutex jobs_lock;
+  GCond jobs_cond;
+
+  /* low-latency mode, pending is only touched with the sink pad's stream
+   * lock held */
+  GstDecLatencyMode latency_mode;
+  GstClockTime max_delay;
+  GstBuffer *pending;
+  gsize pending_fill;
+  GstClockTime pending_since;
+  GstClock *sysclock;
+  GstClockID timeout_id;
+
+  /* output caps are sent with the first output, the segment and tags that
+   * arrive before that are held back so they follow the caps */
+  gboolean need_caps;
+  gchar *fname;
+  GstEvent *segment_event;
+  GstTagList *pending_tags;
+
+  /* digest of everything pushed since the stream started */
+  GstDecDigest digest;
+  GzdecDigest *digester;
+  guint64 digest_bytes;
+
+  /* record alignment, carry is the incomplete last record of the previous
+   * output, it shares the memory of the buffer it was cut from */
+  GstDecAlign align;
+  guint delimiter;
+  guint record_size;
+  GstBuffer *carry;
+
+  /* output memory, NULL for system memory. Stream mode takes its buffers
+   * from outpool so the memfds are recycled. lazy wraps per-buffer objects
+   * instead of decoding them. */
+  GstDecAllocator allocator_mode;
+  GstAllocator *allocator;
+  GstBufferPool *outpool;
+  GstAllocator *lazy;
+
+  /* resource limits, 0 for none. The max-rate bucket holds up to one second
+   * of output and goes negative by what the last read produced. */
+  guint64 max_output_bytes;
+  guint max_ratio;
+  guint64 max_rate;
+  gint64 rate_tokens;
+  gint64 rate_time;
 };
 
 /* the capabilities of the inputs and outputs.
@@ -97,7 +215,8 @@ struct _GstGzdec
 static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE("sink",
                                                                    GST_PAD_SINK,
                                                                    GST_PAD_ALWAYS,
-                                                                   GST_STATIC_CAPS("application/x-gzip"));
+                                                                   GST_STATIC_CAPS("application/x-gzip; application/gzip; "
+                                                                                   "application/x-bzip; application/x-bzip2"));
 
 static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE("src",
                                                                   GST_PAD_SRC,
@@ -107,7 +226,7 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE("src",
 #define gst_gzdec_parent_class parent_class
 G_DEFINE_TYPE(GstGzdec, gst_gzdec, GST_TYPE_ELEMENT);
 
-GST_ELEMENT_REGISTER_DEFINE(gzdec, "gzdec", GST_RANK_NONE,
+GST_ELEMENT_REGISTER_DEFINE(gzdec, "gzdec", GST_RANK_PRIMARY,
                             GST_TYPE_GZDEC);
 
 static void gst_gzdec_set_property(GObject *object,
@@ -116,6 +235,16 @@ static void gst_gzdec_get_property(GObject *object,
                                    guint prop_id, GValue *value, GParamSpec *pspec);
 static GstFlowReturn gst_gzdec_chain(GstPad *pad,
                                      GstObject *parent, GstBuffer *buf);
+static gboolean gst_gzdec_sink_event(GstPad *pad,
+                                     GstObject *parent, GstEvent *event);
+static gboolean gst_gzdec_sink_activate(GstPad *pad, GstObject *parent);
+static gboolean gst_gzdec_src_query(GstPad *pad,
+                                    GstObject *parent, GstQuery *query);
+static void gzdec_worker_func(gpointer data, gpointer user_data);
+static void gst_gzdec_discard_jobs(GstGzdec *dec);
+static void gst_gzdec_cancel_timeout(GstGzdec *dec);
+static void gst_gzdec_drop_pending(GstGzdec *dec);
+static void gst_gzdec_reset_caps(GstGzdec *dec);
 
 GType gst_method_get_type(void)
 {
@@ -129,6 +258,12 @@ GType gst_method_get_type(void)
         {BZLIB,
          "BZLIB method",
          "bzlib"},
+        {BZIP2,
+         "Built-in bzip2 decoder",
+         "bzip2"},
+        {AUTO,
+         "Detect gzip or bzip2 (bzlib) from the magic bytes",
+         "auto"},
         {0, NULL, NULL},
     };
 
@@ -141,6 +276,193 @@ GType gst_method_get_type(void)
   return gzdec_type;
 }
 
+GType gst_framing_get_type(void)
+{
+  static GType framing_type = 0;
+
+  if (g_once_init_enter(&framing_type))
+  {
+    static GEnumValue framing_types[] = {
+        {FRAMING_STREAM, "Input is one continuous compressed stream",
+         "stream"},
+        {FRAMING_PER_BUFFER,
+         "Each input buffer is a self-contained compressed object",
+         "per-buffer"},
+        {0, NULL, NULL},
+    };
+
+    GType temp = g_enum_register_static("GstDecFraming",
+                                        framing_types);
+
+    g_once_init_leave(&framing_type, temp);
+  }
+
+  return framing_type;
+}
+
+GType gst_verify_get_type(void)
+{
+  static GType verify_type = 0;
+
+  if (g_once_init_enter(&verify_type))
+  {
+    static GEnumValue verify_types[] = {
+        {VERIFY_NONE, "Trust the input, skip all checksums",
+         "none"},
+        {VERIFY_CRC32, "Check the gzip CRC-32 with zlib",
+         "crc32"},
+        {VERIFY_CRC32_FAST, "Check the gzip CRC-32 with carry-less multiply folding",
+         "crc32-fast"},
+        {0, NULL, NULL},
+    };
+
+    GType temp = g_enum_register_static("GstDecVerify",
+                                        verify_types);
+
+    g_once_init_leave(&verify_type, temp);
+  }
+
+  return verify_type;
+}
+
+GType gst_latency_mode_get_type(void)
+{
+  static GType latency_mode_type = 0;
+
+  if (g_once_init_enter(&latency_mode_type))
+  {
+    static GEnumValue latency_mode_types[] = {
+        {LATENCY_THROUGHPUT, "Push output as it is decoded",
+         "throughput"},
+        {LATENCY_LOW,
+         "Push at every sync/full flush point, coalescing small outputs up to max-delay",
+         "low-latency"},
+        {0, NULL, NULL},
+    };
+
+    GType temp = g_enum_register_static("GstDecLatencyMode",
+                                        latency_mode_types);
+
+    g_once_init_leave(&latency_mode_type, temp);
+  }
+
+  return latency_mode_type;
+}
+
+GType gst_digest_get_type(void)
+{
+  static GType digest_type = 0;
+
+  if (g_once_init_enter(&digest_type))
+  {
+    static GEnumValue digest_types[] = {
+        {DIGEST_NONE, "No digest",
+         "none"},
+        {DIGEST_XXH3, "64-bit XXH3 (needs libxxhash)",
+         "xxh3"},
+        {DIGEST_SHA256, "SHA-256",
+         "sha256"},
+        {DIGEST_CRC32C, "CRC-32C (Castagnoli)",
+         "crc32c"},
+        {0, NULL, NULL},
+    };
+
+    GType temp = g_enum_register_static("GstDecDigest",
+                                        digest_types);
+
+    g_once_init_leave(&digest_type, temp);
+  }
+
+  return digest_type;
+}
+
+static const gchar *gst_gzdec_digest_nick(GstDecDigest digest)
+{
+  return g_enum_get_value(g_type_class_peek(GST_TYPE_DIGEST), digest)->value_nick;
+}
+
+GType gst_align_get_type(void)
+{
+  static GType align_type = 0;
+
+  if (g_once_init_enter(&align_type))
+  {
+    static GEnumValue align_types[] = {
+        {ALIGN_NONE, "Output buffers end wherever decoding stopped",
+         "none"},
+        {ALIGN_NEWLINE, "Output buffers end after a newline",
+         "newline"},
+        {ALIGN_DELIMITER, "Output buffers end after the delimiter byte",
+         "delimiter"},
+        {ALIGN_RECORD, "Output buffers hold whole records of record-size bytes",
+         "record"},
+        {0, NULL, NULL},
+    };
+
+    GType temp = g_enum_register_static("GstDecAlign",
+                                        align_types);
+
+    g_once_init_leave(&align_type, temp);
+  }
+
+  return align_type;
+}
+
+GType gst_allocator_mode_get_type(void)
+{
+  static GType allocator_type = 0;
+
+  if (g_once_init_enter(&allocator_type))
+  {
+    static GEnumValue allocator_types[] = {
+        {ALLOCATOR_SYSTEM, "Plain system memory",
+         "system"},
+        {ALLOCATOR_MEMFD, "memfd-backed fd memory, huge chunks use transparent huge pages",
+         "memfd"},
+        {ALLOCATOR_MEMFD_HUGETLB, "memfd-backed fd memory from the hugetlbfs pool",
+         "memfd-hugetlb"},
+        {ALLOCATOR_LAZY, "Per-buffer gzip objects are decoded only when the output is mapped",
+         "lazy"},
+        {0, NULL, NULL},
+    };
+
+    GType temp = g_enum_register_static("GstDecAllocator",
+                                        allocator_types);
+
+    g_once_init_leave(&allocator_type, temp);
+  }
+
+  return allocator_type;
+}
+
+static GzdecCoreFormat gzdec_core_format(GstDecMethod method)
+{
+  switch (method)
+  {
+  case BZLIB:
+    return GZDEC_CORE_BZIP2;
+  case BZIP2:
+    return GZDEC_CORE_BZIP2_BUILTIN;
+  case AUTO:
+    return GZDEC_CORE_AUTO;
+  default:
+    return GZDEC_CORE_GZIP;
+  }
+}
+
+static GzdecCoreVerify gzdec_core_verify(GstDecVerify verify)
+{
+  switch (verify)
+  {
+  case VERIFY_NONE:
+    return GZDEC_CORE_VERIFY_NONE;
+  case VERIFY_CRC32_FAST:
+    return GZDEC_CORE_VERIFY_CRC32_FAST;
+  default:
+    return GZDEC_CORE_VERIFY_CRC32;
+  }
+}
+
 /* GObject vmethod implementations */
 static void
 gst_gzdec_decompress_end(GstGzdec *dec)
@@ -150,16 +472,8 @@ gst_gzdec_decompress_end(GstGzdec *dec)
   if (dec->ready)
   {
     GST_DEBUG_OBJECT(dec, "Finalize gzdec decompressing library");
-    if (dec->method == ZLIB)
-    {
-      inflateEnd(&dec->stream);
-      memset(&dec->stream, 0, sizeof(dec->stream));
-    }
-    else
-    {
-      BZ2_bzDecompressEnd(&dec->bz_stream);
-      memset(&dec->bz_stream, 0, sizeof(dec->bz_stream));
-    }
+    gzdec_core_free(dec->core);
+    dec->core = NULL;
     dec->ready = FALSE;
   }
 }
@@ -170,34 +484,148 @@ gst_gzdec_finalize(GObject *object)
   GstGzdec *dec = GST_GZDEC(object);
   GST_DEBUG_OBJECT(dec, "Finalize gzdec");
   gst_gzdec_decompress_end(dec);
+  gst_gzdec_reset_caps(dec);
+  gzdec_digest_free(dec->digester);
+  gst_buffer_replace(&dec->carry, NULL);
+  gst_buffer_replace(&dec->leftover, NULL);
+  gst_object_unref(dec->sysclock);
+  g_mutex_clear(&dec->jobs_lock);
+  g_cond_clear(&dec->jobs_cond);
   G_OBJECT_CLASS(parent_class)->finalize(object);
 }
 
 static void gst_gzdec_decompress_init(GstGzdec *dec)
 {
-  gint ret;
   g_return_if_fail(GST_IS_GZDEC(dec));
 
   gst_gzdec_decompress_end(dec);
-  if (dec->method == ZLIB)
+  dec->core = gzdec_core_new(gzdec_core_format(dec->method), gzdec_core_verify(dec->verify));
+  if (dec->core)
+    gzdec_core_set_flush_points(dec->core, dec->latency_mode == LATENCY_LOW);
+  if (dec->method == ZLIB || dec->method == AUTO)
+    GST_DEBUG_OBJECT(dec, "Verifying with %s CRC-32",
+                     dec->verify == VERIFY_CRC32_FAST ? gzdec_crc32_fast_impl() : "zlib");
+  dec->in_offset = 0;
+  dec->out_offset = 0;
+  gst_buffer_replace(&dec->leftover, NULL);
+  dec->ready = dec->core != NULL;
+  return;
+}
+
+/* Called from FLUSH_START without the stream lock, the chain function sees
+ * the flag between iterations and a drain blocked on the workers wakes up */
+static void gst_gzdec_set_flushing(GstGzdec *dec)
+{
+  g_atomic_int_set(&dec->flushing, TRUE);
+  g_mutex_lock(&dec->jobs_lock);
+  g_cond_broadcast(&dec->jobs_cond);
+  g_mutex_unlock(&dec->jobs_lock);
+}
+
+/* Decoder owned by a worker thread, reused for every object it decodes */
+typedef struct
+{
+  GstDecMethod method;
+  GzdecCore *core;
+} GzdecWorkerCtx;
+
+static void gzdec_worker_ctx_free(gpointer data)
+{
+  GzdecWorkerCtx *ctx = data;
+
+  gzdec_core_free(ctx->core);
+  g_free(ctx);
+}
+
+static GPrivate gzdec_worker_ctx = G_PRIVATE_INIT(gzdec_worker_ctx_free);
+
+static GzdecWorkerCtx *gzdec_worker_ctx_get(GstDecMethod method)
+{
+  GzdecWorkerCtx *ctx = g_private_get(&gzdec_worker_ctx);
+
+  if (ctx && ctx->method == method)
+    return ctx;
+
+  ctx = g_new0(GzdecWorkerCtx, 1);
+  ctx->method = method;
+  ctx->core = gzdec_core_new(gzdec_core_format(method), gzdec_core_verify(DEFAULT_VERIFY));
+  /* frees the context of the previous method, if any */
+  g_private_replace(&gzdec_worker_ctx, ctx);
+  return ctx;
+}
+
+/* One self-contained input buffer travelling through the worker pool */
+typedef struct
+{
+  GstBuffer *in;
+  GstBuffer *out;
+  GstDecMethod method;
+  GstDecVerify verify;
+  GstAllocator *allocator;
+  gsize predicted;
+  guint64 limit;
+  gboolean done;
+} GzdecJob;
+
+static void gzdec_job_free(gpointer data)
+{
+  GzdecJob *job = data;
+
+  gst_buffer_unref(job->in);
+  if (job->out)
+    gst_buffer_unref(job->out);
+  g_free(job);
+}
+
+/* Output goes to memfds, stream mode recycles them through a buffer pool */
+static gboolean gst_gzdec_start_allocator(GstGzdec *dec)
+{
+  GstStructure *config;
+
+  if (dec->allocator_mode == ALLOCATOR_LAZY)
   {
-    dec->stream.zalloc = Z_NULL;
-    dec->stream.zfree = Z_NULL;
-    dec->stream.opaque = Z_NULL;
-    dec->stream.avail_in = 0;
-    dec->stream.next_in = Z_NULL;
-    // MAX_WBITS + 16  to deflate (RFC 1952)
-    ret = inflateInit2(&dec->stream, MAX_WBITS + 16);
+    /* a stream has no object boundaries to defer decoding to */
+    if (dec->framing == FRAMING_PER_BUFFER)
+      dec->lazy = gst_gzdec_lazy_allocator_new();
+    else
+      GST_WARNING_OBJECT(dec, "allocator=lazy needs framing=per-buffer, decoding eagerly");
+    return TRUE;
   }
-  else
+
+  dec->allocator = gst_gzdec_memfd_allocator_new(dec->allocator_mode == ALLOCATOR_MEMFD_HUGETLB);
+  if (dec->allocator == NULL)
   {
-    dec->bz_stream.bzalloc = NULL;
-    dec->bz_stream.bzfree = NULL;
-    dec->bz_stream.opaque = NULL;
-    ret = BZ2_bzDecompressInit(&dec->bz_stream, 0, 0);
+    GST_ELEMENT_ERROR(dec, RESOURCE, SETTINGS, (NULL),
+                      ("memfd output buffers are not available in this build"));
+    return FALSE;
   }
-  dec->ready = TRUE;
-  return;
+
+  dec->outpool = gst_buffer_pool_new();
+  config = gst_buffer_pool_get_config(dec->outpool);
+  gst_buffer_pool_config_set_params(config, NULL, MEMFD_DEC_SIZE, 2, 0);
+  gst_buffer_pool_config_set_allocator(config, dec->allocator, NULL);
+  if (!gst_buffer_pool_set_config(dec->outpool, config) ||
+      !gst_buffer_pool_set_active(dec->outpool, TRUE))
+  {
+    GST_ELEMENT_ERROR(dec, RESOURCE, NO_SPACE_LEFT, (NULL),
+                      ("Failed to allocate memfd output buffers"));
+    gst_clear_object(&dec->outpool);
+    gst_clear_object(&dec->allocator);
+    return FALSE;
+  }
+  GST_DEBUG_OBJECT(dec, "Decoding into memfd buffers");
+  return TRUE;
+}
+
+static void gst_gzdec_stop_allocator(GstGzdec *dec)
+{
+  if (dec->outpool)
+  {
+    gst_buffer_pool_set_active(dec->outpool, FALSE);
+    gst_clear_object(&dec->outpool);
+  }
+  gst_clear_object(&dec->allocator);
+  gst_clear_object(&dec->lazy);
 }
 
 static GstStateChangeReturn
@@ -208,12 +636,79 @@ gst_gzdec_change_state(GstElement *element, GstStateChange transition)
   GstStateChangeReturn ret;
 
   GST_DEBUG_OBJECT(dec, "Changing gzdec state");
+  /* method and verify may have changed since NULL_TO_READY */
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED)
+  {
+    g_atomic_int_set(&dec->flushing, FALSE);
+    gst_gzdec_decompress_init(dec);
+    dec->rate_tokens = MIN(dec->max_rate, G_MAXINT64);
+    dec->rate_time = g_get_monotonic_time();
+  }
+  /* a chain call still decoding gives the stream lock back quickly */
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    gst_gzdec_set_flushing(dec);
+  /* what can fail first, so a failure leaves nothing behind */
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED && dec->allocator_mode != ALLOCATOR_SYSTEM &&
+      !gst_gzdec_start_allocator(dec))
+    return GST_STATE_CHANGE_FAILURE;
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED && dec->digest != DIGEST_NONE)
+  {
+    gzdec_digest_free(dec->digester);
+    dec->digester = gzdec_digest_new((GzdecDigestType)dec->digest);
+    if (dec->digester == NULL)
+    {
+      GST_ELEMENT_ERROR(dec, LIBRARY, SETTINGS, (NULL),
+                        ("digest %s is not available in this build",
+                         gst_gzdec_digest_nick(dec->digest)));
+      gst_gzdec_stop_allocator(dec);
+      return GST_STATE_CHANGE_FAILURE;
+    }
+    GST_DEBUG_OBJECT(dec, "Digest with %s", gzdec_digest_impl((GzdecDigestType)dec->digest));
+    dec->digest_bytes = 0;
+  }
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED &&
+      dec->framing == FRAMING_PER_BUFFER && dec->threads != 1)
+  {
+    GstGzdecPool *pool = gst_gzdec_pool_get_default();
+
+    GST_DEBUG_OBJECT(dec, "Decoding per-buffer objects on up to %u shared threads",
+                     dec->threads ? dec->threads : gst_gzdec_pool_get_max_threads(pool));
+    dec->client = gst_gzdec_pool_client_new(pool, dec->threads, dec->priority);
+    gst_object_unref(pool);
+  }
+
   ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE && transition == GST_STATE_CHANGE_READY_TO_PAUSED)
+  {
+    if (dec->client)
+    {
+      gst_gzdec_pool_client_free(dec->client);
+      dec->client = NULL;
+    }
+    gzdec_digest_free(dec->digester);
+    dec->digester = NULL;
+    gst_gzdec_stop_allocator(dec);
+  }
   if (ret != GST_STATE_CHANGE_SUCCESS)
     return ret;
   switch (transition)
   {
   case GST_STATE_CHANGE_PAUSED_TO_READY:
+    gst_gzdec_cancel_timeout(dec);
+    GST_PAD_STREAM_LOCK(dec->sinkpad);
+    gst_gzdec_drop_pending(dec);
+    GST_PAD_STREAM_UNLOCK(dec->sinkpad);
+    if (dec->client)
+    {
+      gst_gzdec_discard_jobs(dec);
+      gst_gzdec_pool_client_free(dec->client);
+      dec->client = NULL;
+    }
+    gst_gzdec_reset_caps(dec);
+    gst_buffer_replace(&dec->carry, NULL);
+    gzdec_digest_free(dec->digester);
+    dec->digester = NULL;
+    gst_gzdec_stop_allocator(dec);
     gst_gzdec_decompress_init(dec);
     break;
   case GST_STATE_CHANGE_NULL_TO_READY:
@@ -248,13 +743,131 @@ gst_gzdec_class_init(GstGzdecClass *klass)
                                   g_param_spec_enum("method",
                                                     "Method",
                                                     "Decompress method",
-                                                    GST_TYPE_METHOD, ZLIB,
+                                                    GST_TYPE_METHOD, DEFAULT_METHOD,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_FRAMING,
+                                  g_param_spec_enum("framing",
+                                                    "Framing",
+                                                    "How compressed objects map to input buffers",
+                                                    GST_TYPE_FRAMING, FRAMING_STREAM,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_THREADS,
+                                  g_param_spec_uint("threads",
+                                                    "Threads",
+                                                    "Shared pool threads decoding per-buffer objects at once "
+                                                    "(0 = any, 1 = decode in the streaming thread)",
+                                                    0, 256, DEFAULT_THREADS,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_MAX_IN_FLIGHT,
+                                  g_param_spec_uint("max-in-flight",
+                                                    "Max in flight",
+                                                    "Maximum number of per-buffer objects being decoded "
+                                                    "before the streaming thread blocks",
+                                                    1, 4096, DEFAULT_MAX_IN_FLIGHT,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_VERIFY,
+                                  g_param_spec_enum("verify",
+                                                    "Verify",
+                                                    "How gzip checksums are verified",
+                                                    GST_TYPE_VERIFY, DEFAULT_VERIFY,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_LATENCY_MODE,
+                                  g_param_spec_enum("latency-mode",
+                                                    "Latency mode",
+                                                    "Trade-off between buffer size and latency for framing=stream",
+                                                    GST_TYPE_LATENCY_MODE, DEFAULT_LATENCY_MODE,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_MAX_DELAY,
+                                  g_param_spec_uint64("max-delay",
+                                                      "Max delay",
+                                                      "Longest time in ns small outputs are held back for "
+                                                      "coalescing in low-latency mode",
+                                                      0, G_MAXUINT64, DEFAULT_MAX_DELAY,
+                                                      (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                       GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property(gobject_class, PROP_PRIORITY,
+                                  g_param_spec_uint("priority",
+                                                    "Priority",
+                                                    "Per-buffer objects decoded per turn when the shared pool "
+                                                    "is busy with other instances",
+                                                    1, 64, DEFAULT_PRIORITY,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_MAX_THREADS,
+                                  g_param_spec_uint("max-threads",
+                                                    "Max threads",
+                                                    "Size of the worker pool shared by all gzdec instances "
+                                                    "in the process (0 = GZDEC_MAX_THREADS or one per CPU)",
+                                                    0, 1024, 0,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_DIGEST,
+                                  g_param_spec_enum("digest",
+                                                    "Digest",
+                                                    "Digest of the decoded output, posted as an element "
+                                                    "message and a tag at EOS",
+                                                    GST_TYPE_DIGEST, DEFAULT_DIGEST,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_ALIGN,
+                                  g_param_spec_enum("align",
+                                                    "Align",
+                                                    "Record boundary every output buffer ends on, for framing=stream",
+                                                    GST_TYPE_ALIGN, DEFAULT_ALIGN,
                                                     (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
                                                      GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_DELIMITER,
+                                  g_param_spec_uint("delimiter",
+                                                    "Delimiter",
+                                                    "Byte that ends a record with align=delimiter",
+                                                    0, 255, DEFAULT_DELIMITER,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_RECORD_SIZE,
+                                  g_param_spec_uint("record-size",
+                                                    "Record size",
+                                                    "Length in bytes of a record with align=record",
+                                                    1, G_MAXINT, DEFAULT_RECORD_SIZE,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_ALLOCATOR,
+                                  g_param_spec_enum("allocator",
+                                                    "Allocator",
+                                                    "Memory the decoded output is written to",
+                                                    GST_TYPE_ALLOCATOR_MODE, DEFAULT_ALLOCATOR,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_MAX_OUTPUT_BYTES,
+                                  g_param_spec_uint64("max-output-bytes",
+                                                      "Max output bytes",
+                                                      "Stop with an error once more than this many bytes would be decoded (0 = unlimited)",
+                                                      0, G_MAXUINT64, DEFAULT_MAX_OUTPUT_BYTES,
+                                                      (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                       GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_MAX_RATIO,
+                                  g_param_spec_uint("max-ratio",
+                                                    "Max ratio",
+                                                    "Stop with an error once the decoded size exceeds this many times the compressed size (0 = unlimited)",
+                                                    0, G_MAXUINT, DEFAULT_MAX_RATIO,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_MAX_RATE,
+                                  g_param_spec_uint64("max-rate",
+                                                      "Max rate",
+                                                      "Decoded bytes per second, decoding blocks above it (0 = unlimited)",
+                                                      0, G_MAXUINT64, DEFAULT_MAX_RATE,
+                                                      (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                       GST_PARAM_MUTABLE_READY)));
 
   gst_element_class_set_details_simple(gstelement_class,
                                        "Gzip decompress",
-                                       "gzdec",
+                                       "Codec/Decoder",
                                        "Element to decompress .gz and .bz2 files", "Lenin Torres <<ttvleninn@gmail.com>>");
 
   gst_element_class_add_pad_template(gstelement_class,
@@ -277,15 +890,50 @@ gst_gzdec_init(GstGzdec *dec)
 
   gst_pad_set_chain_function(dec->sinkpad,
                              GST_DEBUG_FUNCPTR(gst_gzdec_chain));
-  GST_PAD_SET_PROXY_CAPS(dec->sinkpad);
+  gst_pad_set_event_function(dec->sinkpad,
+                             GST_DEBUG_FUNCPTR(gst_gzdec_sink_event));
+  gst_pad_set_activate_function(dec->sinkpad,
+                                GST_DEBUG_FUNCPTR(gst_gzdec_sink_activate));
   gst_element_add_pad(GST_ELEMENT(dec), dec->sinkpad);
 
   dec->srcpad = gst_pad_new_from_static_template(&src_factory, "src");
-  GST_PAD_SET_PROXY_CAPS(dec->srcpad);
+  gst_pad_set_query_function(dec->srcpad,
+                             GST_DEBUG_FUNCPTR(gst_gzdec_src_query));
   gst_element_add_pad(GST_ELEMENT(dec), dec->srcpad);
 
   dec->silent = FALSE;
-  dec->method = ZLIB;
+  dec->method = DEFAULT_METHOD;
+  dec->framing = FRAMING_STREAM;
+  dec->threads = DEFAULT_THREADS;
+  dec->max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+  dec->verify = DEFAULT_VERIFY;
+  dec->priority = DEFAULT_PRIORITY;
+  dec->client = NULL;
+  dec->duration = 0;
+  dec->latency_mode = DEFAULT_LATENCY_MODE;
+  dec->max_delay = DEFAULT_MAX_DELAY;
+  dec->pending = NULL;
+  dec->timeout_id = NULL;
+  dec->need_caps = TRUE;
+  dec->digest = DEFAULT_DIGEST;
+  dec->digester = NULL;
+  dec->align = DEFAULT_ALIGN;
+  dec->delimiter = DEFAULT_DELIMITER;
+  dec->record_size = DEFAULT_RECORD_SIZE;
+  dec->carry = NULL;
+  dec->flushing = FALSE;
+  dec->leftover = NULL;
+  dec->allocator_mode = DEFAULT_ALLOCATOR;
+  dec->allocator = NULL;
+  dec->outpool = NULL;
+  dec->lazy = NULL;
+  dec->max_output_bytes = DEFAULT_MAX_OUTPUT_BYTES;
+  dec->max_ratio = DEFAULT_MAX_RATIO;
+  dec->max_rate = DEFAULT_MAX_RATE;
+  dec->sysclock = gst_system_clock_obtain();
+  g_queue_init(&dec->jobs);
+  g_mutex_init(&dec->jobs_lock);
+  g_cond_init(&dec->jobs_cond);
 }
 
 static void
@@ -301,6 +949,59 @@ gst_gzdec_set_property(GObject *object, guint prop_id,
   case PROP_METHOD:
     dec->method = g_value_get_enum(value);
     break;
+  case PROP_FRAMING:
+    dec->framing = g_value_get_enum(value);
+    break;
+  case PROP_THREADS:
+    dec->threads = g_value_get_uint(value);
+    break;
+  case PROP_MAX_IN_FLIGHT:
+    dec->max_in_flight = g_value_get_uint(value);
+    break;
+  case PROP_VERIFY:
+    dec->verify = g_value_get_enum(value);
+    break;
+  case PROP_LATENCY_MODE:
+    dec->latency_mode = g_value_get_enum(value);
+    break;
+  case PROP_MAX_DELAY:
+    dec->max_delay = g_value_get_uint64(value);
+    break;
+  case PROP_PRIORITY:
+    dec->priority = g_value_get_uint(value);
+    break;
+  case PROP_MAX_THREADS:
+  {
+    GstGzdecPool *pool = gst_gzdec_pool_get_default();
+
+    gst_gzdec_pool_set_max_threads(pool, g_value_get_uint(value));
+    gst_object_unref(pool);
+    break;
+  }
+  case PROP_DIGEST:
+    dec->digest = g_value_get_enum(value);
+    break;
+  case PROP_ALIGN:
+    dec->align = g_value_get_enum(value);
+    break;
+  case PROP_DELIMITER:
+    dec->delimiter = g_value_get_uint(value);
+    break;
+  case PROP_RECORD_SIZE:
+    dec->record_size = g_value_get_uint(value);
+    break;
+  case PROP_ALLOCATOR:
+    dec->allocator_mode = g_value_get_enum(value);
+    break;
+  case PROP_MAX_OUTPUT_BYTES:
+    dec->max_output_bytes = g_value_get_uint64(value);
+    break;
+  case PROP_MAX_RATIO:
+    dec->max_ratio = g_value_get_uint(value);
+    break;
+  case PROP_MAX_RATE:
+    dec->max_rate = g_value_get_uint64(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -321,112 +1022,1072 @@ gst_gzdec_get_property(GObject *object, guint prop_id,
   case PROP_METHOD:
     g_value_set_enum(value, dec->method);
     break;
+  case PROP_FRAMING:
+    g_value_set_enum(value, dec->framing);
+    break;
+  case PROP_THREADS:
+    g_value_set_uint(value, dec->threads);
+    break;
+  case PROP_MAX_IN_FLIGHT:
+    g_value_set_uint(value, dec->max_in_flight);
+    break;
+  case PROP_VERIFY:
+    g_value_set_enum(value, dec->verify);
+    break;
+  case PROP_LATENCY_MODE:
+    g_value_set_enum(value, dec->latency_mode);
+    break;
+  case PROP_MAX_DELAY:
+    g_value_set_uint64(value, dec->max_delay);
+    break;
+  case PROP_PRIORITY:
+    g_value_set_uint(value, dec->priority);
+    break;
+  case PROP_MAX_THREADS:
+  {
+    GstGzdecPool *pool = gst_gzdec_pool_get_default();
+
+    g_value_set_uint(value, gst_gzdec_pool_get_max_threads(pool));
+    gst_object_unref(pool);
+    break;
+  }
+  case PROP_DIGEST:
+    g_value_set_enum(value, dec->digest);
+    break;
+  case PROP_ALIGN:
+    g_value_set_enum(value, dec->align);
+    break;
+  case PROP_DELIMITER:
+    g_value_set_uint(value, dec->delimiter);
+    break;
+  case PROP_RECORD_SIZE:
+    g_value_set_uint(value, dec->record_size);
+    break;
+  case PROP_ALLOCATOR:
+    g_value_set_enum(value, dec->allocator_mode);
+    break;
+  case PROP_MAX_OUTPUT_BYTES:
+    g_value_set_uint64(value, dec->max_output_bytes);
+    break;
+  case PROP_MAX_RATIO:
+    g_value_set_uint(value, dec->max_ratio);
+    break;
+  case PROP_MAX_RATE:
+    g_value_set_uint64(value, dec->max_rate);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
   }
 }
 
-/* GstElement vmethod implementations */
-static GstFlowReturn process_buffer_zlib(GstGzdec *dec, GstBuffer *buf)
+/* Caps of the decoded data from the extension of the original file name */
+static GstCaps *gst_gzdec_caps_from_name(const gchar *name)
 {
-  g_return_if_fail(GST_IS_GZDEC(dec));
-
-  GstFlowReturn flow = GST_FLOW_OK;
-  GstBuffer *outbuf;
-  gint err;
-
-  GstMapInfo inmap = GST_MAP_INFO_INIT, outmap;
-
-  gst_buffer_map(buf, &inmap, GST_MAP_READ);
-  dec->stream.next_in = (z_const gchar *)inmap.data;
-  dec->stream.avail_in = inmap.size;
-  do
+  static const struct
   {
-    outbuf = gst_buffer_new_and_alloc(DEFAULT_DEC_SIZE);
-    gst_buffer_map(outbuf, &outmap, GST_MAP_WRITE);
-    dec->stream.next_out = (gchar *)outmap.data;
-    dec->stream.avail_out = outmap.size;
-
-    gst_buffer_unmap(outbuf, &outmap);
-    err = inflate(&dec->stream, Z_NO_FLUSH);
-
-    if (dec->stream.avail_out >= gst_buffer_get_size(outbuf))
+    const gchar *ext;
+    const gchar *caps;
+  } types[] = {
+      {".tar", "application/x-tar"},
+      {".csv", "text/csv"},
+      {".json", "application/json"},
+      {".ts", "video/mpegts, systemstream=(boolean)true, packetsize=(int)188"},
+      {".wav", "audio/x-wav"},
+  };
+  gchar *lower = g_ascii_strdown(name, -1);
+  GstCaps *caps = NULL;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(types); i++)
+  {
+    if (g_str_has_suffix(lower, types[i].ext))
     {
-      gst_buffer_unref(outbuf);
+      caps = gst_caps_from_string(types[i].caps);
       break;
     }
+  }
+  g_free(lower);
+  return caps;
+}
 
-    gst_buffer_resize(outbuf, 0, gst_buffer_get_size(outbuf) - dec->stream.avail_out);
-    GST_BUFFER_OFFSET(outbuf) = dec->stream.total_out - gst_buffer_get_size(outbuf);
-    GST_DEBUG_OBJECT(dec, "Push data on src pad");
-
-    /* Push data */
-    flow = gst_pad_push(dec->srcpad, outbuf);
-    if (flow != GST_FLOW_OK)
-    {
+/* Quick look at the first decoded bytes, for when the name says nothing */
+static GstCaps *gst_gzdec_sniff_caps(const guint8 *data, gsize size)
+{
+  gsize i;
+
+  if (size >= 262 && memcmp(data + 257, "ustar", 5) == 0)
+    return gst_caps_new_empty_simple("application/x-tar");
+  if (size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0)
+    return gst_caps_new_empty_simple("audio/x-wav");
+  /* three sync bytes 188 bytes apart */
+  if (size >= 377 && data[0] == 0x47 && data[188] == 0x47 && data[376] == 0x47)
+    return gst_caps_from_string("video/mpegts, systemstream=(boolean)true, packetsize=(int)188");
+
+  for (i = 0; i < size && g_ascii_isspace(data[i]); i++)
+    ;
+  if (i < size && (data[i] == '{' || data[i] == '['))
+    return gst_caps_new_empty_simple("application/json");
+
+  /* no control characters besides white space in the first 512 bytes */
+  for (i = 0; i < size && i < 512; i++)
+  {
+    if (data[i] < 0x20 && !g_ascii_isspace(data[i]))
       break;
-    }
-  } while (err != Z_STREAM_END);
-
-
-  gst_buffer_unmap(buf, &inmap);
-  gst_buffer_unref(buf);
-  return flow;
+  }
+  if (size > 0 && (i == size || i == 512))
+    return gst_caps_new_empty_simple("text/plain");
 
+  return gst_caps_new_empty_simple("application/octet-stream");
 }
 
-static GstFlowReturn process_buffer_bzlib(GstGzdec *dec, GstBuffer *buf)
+/* Send the output caps, then the segment and tags held back for them */
+static void gst_gzdec_negotiate(GstGzdec *dec, const guint8 *data, gsize size)
 {
-  g_return_if_fail(GST_IS_GZDEC(dec));
-  GstFlowReturn flow = GST_FLOW_OK;
-  GstBuffer *outbuf;
-  gint err;
+  GstCaps *caps = NULL;
 
-  GstMapInfo inmap = GST_MAP_INFO_INIT, outmap;
+  if (!dec->need_caps)
+    return;
+  dec->need_caps = FALSE;
 
-  gst_buffer_map(buf, &inmap, GST_MAP_READ);
-  dec->bz_stream.next_in = (gchar *)inmap.data;
-  dec->bz_stream.avail_in = inmap.size;
+  if (dec->fname)
+    caps = gst_gzdec_caps_from_name(dec->fname);
+  if (caps == NULL)
+    caps = gst_gzdec_sniff_caps(data, size);
+  GST_DEBUG_OBJECT(dec, "Output caps %" GST_PTR_FORMAT, caps);
+  gst_pad_push_event(dec->srcpad, gst_event_new_caps(caps));
+  gst_caps_unref(caps);
 
-  do
+  if (dec->segment_event)
   {
-    /* Create the output buffer */
-    outbuf = gst_buffer_new_and_alloc(DEFAULT_DEC_SIZE);
-
-    gst_buffer_map(outbuf, &outmap, GST_MAP_WRITE);
-    dec->bz_stream.next_out = (gchar *)outmap.data;
-    dec->bz_stream.avail_out = outmap.size;
-    err = BZ2_bzDecompress(&dec->bz_stream);
-    gst_buffer_unmap(outbuf, &outmap);
-    if ((err != BZ_OK) && (err != BZ_STREAM_END))
-    {
-      GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL), ("Failed to decompress data"));
-      gst_gzdec_decompress_init(dec);
-      gst_buffer_unref(outbuf);
-      flow = GST_FLOW_ERROR;
-      break;
-    }
+    gst_pad_push_event(dec->srcpad, dec->segment_event);
+    dec->segment_event = NULL;
+  }
+  if (dec->pending_tags)
+  {
+    gst_pad_push_event(dec->srcpad, gst_event_new_tag(dec->pending_tags));
+    dec->pending_tags = NULL;
+  }
+}
 
-    if (dec->bz_stream.avail_out >= gst_buffer_get_size(outbuf))
-    {
-      gst_buffer_unref(outbuf);
-      break;
-    }
-    gst_buffer_resize(outbuf, 0, gst_buffer_get_size(outbuf) - dec->bz_stream.avail_out);
-    GST_BUFFER_OFFSET(outbuf) = dec->bz_stream.total_out_lo32 - gst_buffer_get_size(outbuf);
+static void gst_gzdec_reset_caps(GstGzdec *dec)
+{
+  dec->need_caps = TRUE;
+  g_clear_pointer(&dec->fname, g_free);
+  gst_event_replace(&dec->segment_event, NULL);
+  g_clear_pointer(&dec->pending_tags, gst_tag_list_unref);
+}
 
-    /* Push data */
-    flow = gst_pad_push(dec->srcpad, outbuf);
-    if (flow != GST_FLOW_OK)
-      break;
-  } while (err != BZ_STREAM_END);
+/* Offset just past the last byte c in data, 0 if there is none. Scans 16
+ * bytes at a time from the end, where the last record boundary usually is */
+static gsize gst_gzdec_find_last(const guint8 *data, gsize size, guint8 c)
+{
+  gsize i = size;
 
+#ifdef __SSE2__
+  const __m128i needle = _mm_set1_epi8((char)c);
 
-  gst_buffer_unmap(buf, &inmap);
-  gst_buffer_unref(buf);
-  return flow;
-}
+  while (i >= 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i - 16));
+    guint mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+
+    if (mask)
+      return i - 16 + (32 - __builtin_clz(mask));
+    i -= 16;
+  }
+#endif
+  while (i > 0)
+  {
+    if (data[i - 1] == c)
+      return i;
+    i--;
+  }
+  return 0;
+}
+
+/* Cut buf after its last complete record. What follows is kept in carry and
+ * goes in front of the next output; both are sub-buffers sharing buf's memory.
+ * Returns NULL when buf does not complete a record */
+static GstBuffer *gst_gzdec_align_buffer(GstGzdec *dec, GstBuffer *buf)
+{
+  GstBuffer *head;
+  GstMapInfo map;
+  guint64 offset, carried = 0;
+  gsize size, cut = 0;
+
+  if (dec->carry)
+  {
+    carried = gst_buffer_get_size(dec->carry);
+    offset = GST_BUFFER_OFFSET(dec->carry);
+  }
+  else
+    offset = GST_BUFFER_OFFSET(buf);
+
+  if (dec->align == ALIGN_RECORD)
+  {
+    size = carried + gst_buffer_get_size(buf);
+    cut = size - size % dec->record_size;
+  }
+  else if (gst_buffer_map(buf, &map, GST_MAP_READ))
+  {
+    /* the carry holds no boundary, only the new data is scanned */
+    cut = gst_gzdec_find_last(map.data, map.size,
+                              dec->align == ALIGN_NEWLINE ? '\n' : dec->delimiter);
+    if (cut)
+      cut += carried;
+    gst_buffer_unmap(buf, &map);
+  }
+
+  /* appending only links the memory of both buffers */
+  if (dec->carry)
+    buf = gst_buffer_append(dec->carry, buf);
+  dec->carry = NULL;
+  size = gst_buffer_get_size(buf);
+  GST_BUFFER_OFFSET(buf) = offset;
+  GST_BUFFER_OFFSET_END(buf) = offset + size;
+
+  if (cut == 0)
+  {
+    dec->carry = buf;
+    return NULL;
+  }
+  if (cut == size)
+    return buf;
+
+  head = gst_buffer_copy_region(buf, GST_BUFFER_COPY_ALL, 0, cut);
+  GST_BUFFER_OFFSET(head) = offset;
+  GST_BUFFER_OFFSET_END(head) = offset + cut;
+  dec->carry = gst_buffer_copy_region(buf, GST_BUFFER_COPY_MEMORY, cut, size - cut);
+  GST_BUFFER_OFFSET(dec->carry) = offset + cut;
+  GST_BUFFER_OFFSET_END(dec->carry) = offset + size;
+  gst_buffer_unref(buf);
+  return head;
+}
+
+/* All output goes through here so the caps precede it and the digest sees
+ * every byte, while the buffer is still hot in the cache */
+static GstFlowReturn gst_gzdec_push(GstGzdec *dec, GstBuffer *buf)
+{
+  GstMapInfo map;
+
+  if (dec->align != ALIGN_NONE && dec->framing == FRAMING_STREAM)
+  {
+    buf = gst_gzdec_align_buffer(dec, buf);
+    if (buf == NULL)
+      return GST_FLOW_OK;
+  }
+
+  /* mapping lazy output would decode it, without a digest its caps come
+   * from the file name alone */
+  if (dec->lazy && !dec->digester)
+    gst_gzdec_negotiate(dec, NULL, 0);
+  else if (dec->need_caps || dec->digester)
+  {
+    if (gst_buffer_map(buf, &map, GST_MAP_READ))
+    {
+      gst_gzdec_negotiate(dec, map.data, map.size);
+      if (dec->digester)
+      {
+        gzdec_digest_update(dec->digester, map.data, map.size);
+        dec->digest_bytes += map.size;
+      }
+      gst_buffer_unmap(buf, &map);
+    }
+    else
+      gst_gzdec_negotiate(dec, NULL, 0);
+  }
+  return gst_pad_push(dec->srcpad, buf);
+}
+
+/* The last record may lack its delimiter, it goes out on its own at the end */
+static GstFlowReturn gst_gzdec_push_carry(GstGzdec *dec)
+{
+  GstBuffer *carry = dec->carry;
+  GstDecAlign align = dec->align;
+  GstFlowReturn flow;
+
+  if (carry == NULL)
+    return GST_FLOW_OK;
+
+  dec->carry = NULL;
+  dec->align = ALIGN_NONE;
+  flow = gst_gzdec_push(dec, carry);
+  dec->align = align;
+  return flow;
+}
+
+static void gst_gzdec_reset_digest(GstGzdec *dec)
+{
+  if (dec->digester)
+    gzdec_digest_reset(dec->digester);
+  dec->digest_bytes = 0;
+}
+
+/* Post the digest of the finished stream and send it downstream as a tag */
+static void gst_gzdec_finish_digest(GstGzdec *dec)
+{
+  gchar hex[GZDEC_DIGEST_HEX_SIZE];
+  const gchar *algorithm;
+  gchar *value;
+
+  if (dec->digester == NULL)
+    return;
+
+  gzdec_digest_finish(dec->digester, hex);
+  algorithm = gst_gzdec_digest_nick(dec->digest);
+  GST_DEBUG_OBJECT(dec, "%s %s of %" G_GUINT64_FORMAT " bytes", algorithm, hex, dec->digest_bytes);
+
+  gst_element_post_message(GST_ELEMENT(dec),
+                           gst_message_new_element(GST_OBJECT(dec),
+                                                   gst_structure_new("gzdec-digest",
+                                                                     "algorithm", G_TYPE_STRING, algorithm,
+                                                                     "digest", G_TYPE_STRING, hex,
+                                                                     "bytes", G_TYPE_UINT64, dec->digest_bytes,
+                                                                     NULL)));
+  value = g_strdup_printf("%s:%s", algorithm, hex);
+  gst_pad_push_event(dec->srcpad,
+                     gst_event_new_tag(gst_tag_list_new(GZDEC_TAG_DIGEST, value, NULL)));
+  g_free(value);
+  gst_gzdec_reset_digest(dec);
+}
+
+/* Send the fields of a freshly parsed gzip header downstream as tags */
+static void gst_gzdec_push_header_tags(GstGzdec *dec, const GzdecCoreHeader *header)
+{
+  GstTagList *tags;
+  GstDateTime *mtime;
+
+  /* the original name also decides the output caps */
+  if (dec->need_caps && header->name)
+  {
+    g_free(dec->fname);
+    dec->fname = g_strdup(header->name);
+  }
+
+  tags = gst_tag_list_new(GST_TAG_CONTAINER_FORMAT, "gzip", NULL);
+  if (header->name)
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_TITLE, header->name, NULL);
+  if (header->comment)
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_COMMENT, header->comment, NULL);
+  /* 0 means no time stamp is available */
+  if (header->mtime)
+  {
+    mtime = gst_date_time_new_from_unix_epoch_utc(header->mtime);
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_DATE_TIME, mtime, NULL);
+    gst_date_time_unref(mtime);
+  }
+
+  if (dec->need_caps)
+  {
+    if (dec->pending_tags)
+    {
+      gst_tag_list_insert(dec->pending_tags, tags, GST_TAG_MERGE_REPLACE);
+      gst_tag_list_unref(tags);
+    }
+    else
+      dec->pending_tags = tags;
+    return;
+  }
+  gst_pad_push_event(dec->srcpad, gst_event_new_tag(tags));
+}
+
+/* GstElement vmethod implementations */
+/* Output allowed by max-ratio after total_in compressed bytes */
+static guint64 gst_gzdec_ratio_limit(GstGzdec *dec, guint64 total_in)
+{
+  guint64 limit = G_MAXUINT64;
+
+  if (total_in <= G_MAXUINT64 / dec->max_ratio)
+    limit = total_in * dec->max_ratio;
+  return MAX(limit, MAX_RATIO_MIN_OUTPUT);
+}
+
+/* How much the next read may decode without the limits being checked
+ * first. It is one byte more than the limits allow, so that
+ * gst_gzdec_check_limits() sees when a stream goes over them. */
+static guint64 gst_gzdec_output_allowance(GstGzdec *dec, guint64 total_in, guint64 total_out)
+{
+  guint64 limit = G_MAXUINT64;
+
+  if (dec->max_output_bytes)
+    limit = dec->max_output_bytes;
+  if (dec->max_ratio)
+    limit = MIN(limit, gst_gzdec_ratio_limit(dec, total_in));
+  if (limit == G_MAXUINT64)
+    return G_MAXUINT64;
+  return limit >= total_out ? limit - total_out + 1 : 0;
+}
+
+/* Error out once the output went over max-output-bytes or max-ratio */
+static GstFlowReturn gst_gzdec_check_limits(GstGzdec *dec, guint64 total_in, guint64 total_out)
+{
+  const gchar *name;
+  guint64 value;
+
+  if (dec->max_output_bytes && total_out > dec->max_output_bytes)
+  {
+    name = "max-output-bytes";
+    value = dec->max_output_bytes;
+  }
+  else if (dec->max_ratio && total_out > gst_gzdec_ratio_limit(dec, total_in))
+  {
+    name = "max-ratio";
+    value = dec->max_ratio;
+  }
+  else
+    return GST_FLOW_OK;
+
+  GST_ELEMENT_ERROR_WITH_DETAILS(dec, STREAM, DECODE,
+                                 ("Decoding stopped, the output is over the %s limit", name),
+                                 ("%" G_GUINT64_FORMAT " bytes decoded from %" G_GUINT64_FORMAT
+                                  " compressed bytes, %s is %" G_GUINT64_FORMAT,
+                                  total_out, total_in, name, value),
+                                 ("limit", G_TYPE_STRING, name,
+                                  "limit-value", G_TYPE_UINT64, value,
+                                  "total-in", G_TYPE_UINT64, total_in,
+                                  "total-out", G_TYPE_UINT64, total_out, NULL));
+  return GST_FLOW_ERROR;
+}
+
+/* Block until the max-rate bucket is not empty, the caller then takes what
+ * it decodes out of it. FALSE when a flush ended the wait. */
+static gboolean gst_gzdec_wait_rate(GstGzdec *dec)
+{
+  gint64 rate = MIN(dec->max_rate, G_MAXINT64 / 2);
+  gint64 now;
+  guint64 refill;
+
+  if (rate == 0)
+    return TRUE;
+
+  /* set_flushing wakes the wait up */
+  g_mutex_lock(&dec->jobs_lock);
+  while (!g_atomic_int_get(&dec->flushing))
+  {
+    now = g_get_monotonic_time();
+    refill = gst_util_uint64_scale(now - dec->rate_time, rate, G_USEC_PER_SEC);
+    if (refill >= (guint64)(rate - dec->rate_tokens))
+    {
+      dec->rate_tokens = rate;
+      dec->rate_time = now;
+    }
+    else
+    {
+      /* keep the time the rounding left over */
+      dec->rate_tokens += refill;
+      dec->rate_time += gst_util_uint64_scale(refill, G_USEC_PER_SEC, rate);
+    }
+    if (dec->rate_tokens > 0)
+      break;
+    g_cond_wait_until(&dec->jobs_cond, &dec->jobs_lock,
+                      now + gst_util_uint64_scale(-dec->rate_tokens, G_USEC_PER_SEC, rate) + 1);
+  }
+  g_mutex_unlock(&dec->jobs_lock);
+
+  return !g_atomic_int_get(&dec->flushing);
+}
+
+/* A flush leaves the rest of the input to the next chain call, the core
+ * keeps the state it needs to carry on from there. Takes buf. */
+static void gst_gzdec_keep_leftover(GstGzdec *dec, GstBuffer *buf, gsize consumed,
+                                    GstFlowReturn flow)
+{
+  gsize size = gst_buffer_get_size(buf);
+
+  if (flow == GST_FLOW_FLUSHING && consumed < size)
+  {
+    GST_DEBUG_OBJECT(dec, "Flushing, keeping %" G_GSIZE_FORMAT " input bytes", size - consumed);
+    /* shares the memory, nothing is copied */
+    dec->leftover = gst_buffer_copy_region(buf, GST_BUFFER_COPY_MEMORY, consumed,
+                                           size - consumed);
+  }
+  gst_buffer_unref(buf);
+}
+
+static GstFlowReturn process_buffer_stream(GstGzdec *dec, GstBuffer *buf)
+{
+  g_return_val_if_fail(GST_IS_GZDEC(dec), GST_FLOW_ERROR);
+
+  GstFlowReturn flow = GST_FLOW_OK;
+  GstBuffer *outbuf;
+  const GzdecCoreHeader *header;
+  GzdecCoreStats stats;
+  gsize written, out_size, consumed = 0, slice;
+  guint64 allowance;
+
+  GstMapInfo inmap = GST_MAP_INFO_INIT, outmap;
+
+  gst_buffer_map(buf, &inmap, GST_MAP_READ);
+  while (flow == GST_FLOW_OK && consumed < inmap.size)
+  {
+    slice = MIN(inmap.size - consumed, MAX_ITERATION_INPUT);
+    gzdec_core_feed(dec->core, inmap.data + consumed, slice);
+    do
+    {
+      if (g_atomic_int_get(&dec->flushing) || !gst_gzdec_wait_rate(dec))
+      {
+        flow = GST_FLOW_FLUSHING;
+        break;
+      }
+      /* the limits are applied before anything is allocated */
+      gzdec_core_get_stats(dec->core, &stats);
+      allowance = gst_gzdec_output_allowance(dec, stats.total_in, stats.total_out);
+      if (dec->outpool)
+      {
+        flow = gst_buffer_pool_acquire_buffer(dec->outpool, &outbuf, NULL);
+        if (flow != GST_FLOW_OK)
+          break;
+      }
+      else
+        outbuf = gst_buffer_new_and_alloc(MIN(DEFAULT_DEC_SIZE, allowance));
+      gst_buffer_map(outbuf, &outmap, GST_MAP_WRITE);
+      out_size = MIN(outmap.size, allowance);
+      if (gzdec_core_read(dec->core, outmap.data, out_size, &written) == GZDEC_CORE_ERROR)
+      {
+        gst_buffer_unmap(outbuf, &outmap);
+        GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL),
+                          ("Failed to decompress data: %s", gzdec_core_error(dec->core)));
+        gzdec_core_reset(dec->core);
+        gst_buffer_unref(outbuf);
+        flow = GST_FLOW_ERROR;
+        break;
+      }
+      gst_buffer_unmap(outbuf, &outmap);
+
+      dec->rate_tokens -= written;
+      gzdec_core_get_stats(dec->core, &stats);
+      flow = gst_gzdec_check_limits(dec, stats.total_in, stats.total_out);
+      if (flow != GST_FLOW_OK)
+      {
+        gst_buffer_unref(outbuf);
+        break;
+      }
+
+      if ((header = gzdec_core_pop_header(dec->core)) != NULL)
+        gst_gzdec_push_header_tags(dec, header);
+
+      if (written == 0)
+      {
+        gst_buffer_unref(outbuf);
+        /* a member ended or a header was consumed, keep going */
+        if (gzdec_core_input_left(dec->core) > 0)
+          continue;
+        break;
+      }
+
+      gst_buffer_resize(outbuf, 0, written);
+      GST_BUFFER_OFFSET(outbuf) = dec->out_offset;
+      dec->out_offset += written;
+      GST_BUFFER_OFFSET_END(outbuf) = dec->out_offset;
+      GST_DEBUG_OBJECT(dec, "Push data on src pad");
+
+      /* Push data */
+      flow = gst_gzdec_push(dec, outbuf);
+      if (flow != GST_FLOW_OK)
+      {
+        break;
+      }
+    } while (gzdec_core_input_left(dec->core) > 0 || written == out_size);
+    consumed += slice - gzdec_core_input_left(dec->core);
+  }
+
+  dec->in_offset += consumed;
+  /* the core must not keep pointing into the unmapped buffer */
+  gzdec_core_feed(dec->core, NULL, 0);
+
+  gst_buffer_unmap(buf, &inmap);
+  gst_gzdec_keep_leftover(dec, buf, consumed, flow);
+  return flow;
+}
+
+/* Push what low-latency mode has collected so far */
+static GstFlowReturn gst_gzdec_push_pending(GstGzdec *dec)
+{
+  GstBuffer *outbuf = dec->pending;
+
+  if (outbuf == NULL || dec->pending_fill == 0)
+    return GST_FLOW_OK;
+
+  dec->pending = NULL;
+  gst_buffer_resize(outbuf, 0, dec->pending_fill);
+  GST_BUFFER_OFFSET(outbuf) = dec->out_offset;
+  dec->out_offset += dec->pending_fill;
+  GST_BUFFER_OFFSET_END(outbuf) = dec->out_offset;
+  dec->pending_fill = 0;
+
+  GST_DEBUG_OBJECT(dec, "Push coalesced data on src pad");
+  return gst_gzdec_push(dec, outbuf);
+}
+
+static void gst_gzdec_drop_pending(GstGzdec *dec)
+{
+  if (dec->pending)
+    gst_buffer_unref(dec->pending);
+  dec->pending = NULL;
+  dec->pending_fill = 0;
+}
+
+static gboolean gst_gzdec_latency_timeout(GstClock *clock, GstClockTime time,
+                                          GstClockID id, gpointer user_data);
+
+static void gst_gzdec_schedule_timeout(GstGzdec *dec, GstClockTime deadline)
+{
+  GstClockID id = gst_clock_new_single_shot_id(dec->sysclock, deadline);
+
+  GST_OBJECT_LOCK(dec);
+  if (dec->timeout_id)
+  {
+    gst_clock_id_unschedule(dec->timeout_id);
+    gst_clock_id_unref(dec->timeout_id);
+  }
+  dec->timeout_id = id;
+  gst_clock_id_wait_async(id, gst_gzdec_latency_timeout, gst_object_ref(dec),
+                          (GDestroyNotify)gst_object_unref);
+  GST_OBJECT_UNLOCK(dec);
+}
+
+static void gst_gzdec_cancel_timeout(GstGzdec *dec)
+{
+  GST_OBJECT_LOCK(dec);
+  if (dec->timeout_id)
+  {
+    gst_clock_id_unschedule(dec->timeout_id);
+    gst_clock_id_unref(dec->timeout_id);
+    dec->timeout_id = NULL;
+  }
+  GST_OBJECT_UNLOCK(dec);
+}
+
+/* Runs on the clock thread when held back output is due. The pending buffer
+ * belongs to whoever holds the stream lock: if the streaming thread is busy
+ * it will see the deadline itself, so just look again a little later. */
+static gboolean gst_gzdec_latency_timeout(GstClock *clock, GstClockTime time,
+                                          GstClockID id, gpointer user_data)
+{
+  GstGzdec *dec = user_data;
+  gboolean current;
+
+  GST_OBJECT_LOCK(dec);
+  current = (dec->timeout_id == id);
+  GST_OBJECT_UNLOCK(dec);
+  if (!current)
+    return TRUE;
+
+  if (!GST_PAD_STREAM_TRYLOCK(dec->sinkpad))
+  {
+    gst_gzdec_schedule_timeout(dec, time + MAX(dec->max_delay / 4, GST_MSECOND));
+    return TRUE;
+  }
+  gst_gzdec_push_pending(dec);
+  GST_PAD_STREAM_UNLOCK(dec->sinkpad);
+  return TRUE;
+}
+
+/* Stream decoding for live senders: output goes out at every flush point
+ * the sender made, and whatever trickles in between is collected into one
+ * buffer for at most max-delay */
+static GstFlowReturn process_buffer_low_latency(GstGzdec *dec, GstBuffer *buf)
+{
+  g_return_val_if_fail(GST_IS_GZDEC(dec), GST_FLOW_ERROR);
+
+  GstFlowReturn flow = GST_FLOW_OK;
+  GzdecCoreStatus status;
+  const GzdecCoreHeader *header;
+  GstClockTime now;
+  GzdecCoreStats stats;
+  gsize written, requested, consumed = 0, slice;
+  guint64 allowance;
+
+  GstMapInfo inmap = GST_MAP_INFO_INIT, outmap;
+
+  gst_buffer_map(buf, &inmap, GST_MAP_READ);
+  while (flow == GST_FLOW_OK && consumed < inmap.size)
+  {
+    slice = MIN(inmap.size - consumed, MAX_ITERATION_INPUT);
+    gzdec_core_feed(dec->core, inmap.data + consumed, slice);
+    do
+    {
+      if (g_atomic_int_get(&dec->flushing) || !gst_gzdec_wait_rate(dec))
+      {
+        flow = GST_FLOW_FLUSHING;
+        break;
+      }
+      gzdec_core_get_stats(dec->core, &stats);
+      allowance = gst_gzdec_output_allowance(dec, stats.total_in, stats.total_out);
+      if (dec->pending == NULL)
+      {
+        dec->pending = gst_buffer_new_allocate(dec->allocator, LOW_LATENCY_BUFFER_SIZE, NULL);
+        dec->pending_fill = 0;
+      }
+      gst_buffer_map(dec->pending, &outmap, GST_MAP_WRITE);
+      requested = MIN(outmap.size - dec->pending_fill, allowance);
+      status = gzdec_core_read(dec->core, outmap.data + dec->pending_fill, requested, &written);
+      gst_buffer_unmap(dec->pending, &outmap);
+      if (status == GZDEC_CORE_ERROR)
+      {
+        GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL),
+                          ("Failed to decompress data: %s", gzdec_core_error(dec->core)));
+        gzdec_core_reset(dec->core);
+        flow = GST_FLOW_ERROR;
+        break;
+      }
+
+      dec->rate_tokens -= written;
+      gzdec_core_get_stats(dec->core, &stats);
+      flow = gst_gzdec_check_limits(dec, stats.total_in, stats.total_out);
+      if (flow != GST_FLOW_OK)
+        break;
+
+      if ((header = gzdec_core_pop_header(dec->core)) != NULL)
+        gst_gzdec_push_header_tags(dec, header);
+
+      if (written > 0 && dec->pending_fill == 0)
+        dec->pending_since = gst_clock_get_time(dec->sysclock);
+      dec->pending_fill += written;
+
+      if (status != GZDEC_CORE_OK || dec->pending_fill == LOW_LATENCY_BUFFER_SIZE)
+        flow = gst_gzdec_push_pending(dec);
+      /* a full read may have left output inside zlib with no input left */
+    } while (flow == GST_FLOW_OK &&
+             (gzdec_core_input_left(dec->core) > 0 || (written > 0 && written == requested)));
+    consumed += slice - gzdec_core_input_left(dec->core);
+  }
+
+  dec->in_offset += consumed;
+  gzdec_core_feed(dec->core, NULL, 0);
+  gst_buffer_unmap(buf, &inmap);
+  gst_gzdec_keep_leftover(dec, buf, consumed, flow);
+
+  /* no flush point yet, hold the tail back until max-delay runs out */
+  if (flow == GST_FLOW_OK && dec->pending_fill > 0)
+  {
+    now = gst_clock_get_time(dec->sysclock);
+    if (now >= dec->pending_since + dec->max_delay)
+      flow = gst_gzdec_push_pending(dec);
+    else
+      gst_gzdec_schedule_timeout(dec, dec->pending_since + dec->max_delay);
+  }
+  return flow;
+}
+
+/* Guess how many bytes a self-contained object decompresses to, so the
+ * common case needs a single allocation */
+static gsize gst_gzdec_predict_size(GstGzdec *dec, const guint8 *data, gsize size)
+{
+  guint64 predicted = 0;
+
+  /* gzip stores the uncompressed size (mod 2^32) in its last 4 bytes */
+  if ((dec->method == ZLIB || dec->method == AUTO) && size >= 18 &&
+      data[0] == 0x1f && data[1] == 0x8b)
+    predicted = gzdec_core_gzip_isize(data + size - 4, size);
+
+  if (predicted == 0 && dec->in_offset > 0)
+    predicted = gst_util_uint64_scale(size, dec->out_offset, dec->in_offset);
+
+  if (predicted == 0)
+    predicted = (guint64)size * 4;
+
+  return MAX(predicted, DEFAULT_DEC_SIZE);
+}
+
+/* Decode one input buffer as a complete compressed object (possibly made of
+ * several concatenated members). Returns NULL if the buffer does not hold
+ * complete objects. Does not touch the element, so workers can call it. */
+static GstBuffer *gzdec_decode_object(GzdecCore *core, GstBuffer *buf, gsize predicted,
+                                      guint64 limit, GstAllocator *allocator)
+{
+  GstBuffer *outbuf;
+  GstMemory *mem;
+  GstMapInfo inmap = GST_MAP_INFO_INIT, outmap;
+  gsize chunk, used, written;
+  guint64 total = 0;
+  gboolean done = FALSE, failed = FALSE;
+
+  gst_buffer_map(buf, &inmap, GST_MAP_READ);
+  chunk = predicted;
+  outbuf = gst_buffer_new();
+
+  /* members or streams follow each other inside the buffer */
+  if (core == NULL || gzdec_core_reset(core) != 0)
+    failed = TRUE;
+  else
+    gzdec_core_feed(core, inmap.data, inmap.size);
+
+  while (!done && !failed)
+  {
+    /* past limit the object is cut short, pushing it reports the error */
+    if (total >= limit)
+      break;
+    chunk = MIN(chunk, limit - total);
+    /* Every chunk after a misprediction is appended as another memory block,
+     * so nothing decoded so far is copied again */
+    mem = gst_allocator_alloc(allocator, chunk, NULL);
+    gst_memory_map(mem, &outmap, GST_MAP_WRITE);
+    used = 0;
+
+    while (used < outmap.size && !done)
+    {
+      if (gzdec_core_read(core, outmap.data + used, outmap.size - used,
+                          &written) == GZDEC_CORE_ERROR)
+      {
+        failed = TRUE;
+        break;
+      }
+      used += written;
+      if (gzdec_core_input_left(core) == 0 && used < outmap.size)
+      {
+        done = gzdec_core_complete(core);
+        /* Input ended before the end of the last member */
+        failed = !done;
+      }
+    }
+
+    gst_memory_unmap(mem, &outmap);
+    total += used;
+    if (used > 0)
+    {
+      gst_memory_resize(mem, 0, used);
+      gst_buffer_append_memory(outbuf, mem);
+    }
+    else
+    {
+      gst_memory_unref(mem);
+    }
+
+    chunk *= 2;
+  }
+
+  if (core)
+    gzdec_core_feed(core, NULL, 0);
+  gst_buffer_unmap(buf, &inmap);
+
+  if (failed)
+  {
+    gst_buffer_unref(outbuf);
+    return NULL;
+  }
+  return outbuf;
+}
+
+/* Push the object decoded from buf, carrying over the input's timestamps,
+ * flags and metas. Takes ownership of both buffers. */
+static GstFlowReturn gst_gzdec_push_framed(GstGzdec *dec, GstBuffer *buf, GstBuffer *outbuf)
+{
+  GstFlowReturn flow;
+  gsize out_size;
+
+  if (outbuf == NULL)
+  {
+    GST_ELEMENT_WARNING(dec, STREAM, DECODE, (NULL),
+                        ("Dropping buffer that is not a complete compressed object"));
+    gst_buffer_unref(buf);
+    return GST_FLOW_OK;
+  }
+
+  out_size = gst_buffer_get_size(outbuf);
+  flow = gst_gzdec_check_limits(dec, dec->in_offset + gst_buffer_get_size(buf),
+                                dec->out_offset + out_size);
+  if (flow == GST_FLOW_OK && !gst_gzdec_wait_rate(dec))
+    flow = GST_FLOW_FLUSHING;
+  if (flow != GST_FLOW_OK)
+  {
+    gst_buffer_unref(outbuf);
+    gst_buffer_unref(buf);
+    return flow;
+  }
+  dec->rate_tokens -= out_size;
+
+  gst_buffer_copy_into(outbuf, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+  GST_BUFFER_OFFSET(outbuf) = dec->out_offset;
+  GST_BUFFER_OFFSET_END(outbuf) = dec->out_offset + out_size;
+  dec->in_offset += gst_buffer_get_size(buf);
+  dec->out_offset += out_size;
+  gst_buffer_unref(buf);
+
+  GST_DEBUG_OBJECT(dec, "Push framed data on src pad");
+  return gst_gzdec_push(dec, outbuf);
+}
+
+/* Output for a gzip object that is only decoded once it is mapped, NULL when
+ * its decoded size is not known from the trailer. The trailer only gives
+ * the size of the last member, objects of several are decoded eagerly. */
+static GstBuffer *gst_gzdec_wrap_lazy(GstGzdec *dec, GstBuffer *buf)
+{
+  GstMapInfo inmap = GST_MAP_INFO_INIT;
+  GstBuffer *outbuf;
+  gsize size = 0;
+
+  if (dec->method != ZLIB && dec->method != AUTO)
+    return NULL;
+  gst_buffer_map(buf, &inmap, GST_MAP_READ);
+  if (inmap.size >= 18 && inmap.data[0] == 0x1f && inmap.data[1] == 0x8b &&
+      gzdec_core_gzip_single_member(inmap.data, inmap.size))
+  {
+    size = gzdec_core_gzip_isize(inmap.data + inmap.size - 4, inmap.size);
+  }
+  gst_buffer_unmap(buf, &inmap);
+  if (size == 0)
+    return NULL;
+
+  outbuf = gst_buffer_new();
+  gst_buffer_append_memory(outbuf, gst_gzdec_lazy_allocator_wrap(dec->lazy, buf, size,
+                                                                 gzdec_core_verify(dec->verify)));
+  gst_buffer_add_gzdec_compressed_meta(outbuf, buf, "gzip");
+  return outbuf;
+}
+
+static GstFlowReturn process_buffer_framed(GstGzdec *dec, GstBuffer *buf)
+{
+  g_return_val_if_fail(GST_IS_GZDEC(dec), GST_FLOW_ERROR);
+
+  GstMapInfo inmap = GST_MAP_INFO_INIT;
+  GstBuffer *outbuf;
+  gsize predicted;
+
+  if (dec->lazy && (outbuf = gst_gzdec_wrap_lazy(dec, buf)) != NULL)
+    return gst_gzdec_push_framed(dec, buf, outbuf);
+
+  gst_buffer_map(buf, &inmap, GST_MAP_READ);
+  predicted = gst_gzdec_predict_size(dec, inmap.data, inmap.size);
+  gst_buffer_unmap(buf, &inmap);
+
+  outbuf = gzdec_decode_object(dec->core, buf, predicted,
+                               gst_gzdec_output_allowance(dec, dec->in_offset + inmap.size,
+                                                          dec->out_offset),
+                               dec->allocator);
+  return gst_gzdec_push_framed(dec, buf, outbuf);
+}
+
+/* worker pool function */
+static void gzdec_worker_func(gpointer data, gpointer user_data)
+{
+  GzdecJob *job = data;
+  GstGzdec *dec = user_data;
+  GzdecWorkerCtx *ctx = gzdec_worker_ctx_get(job->method);
+
+  if (ctx->core)
+    gzdec_core_set_verify(ctx->core, gzdec_core_verify(job->verify));
+  job->out = gzdec_decode_object(ctx->core, job->in, job->predicted, job->limit, job->allocator);
+
+  g_mutex_lock(&dec->jobs_lock);
+  job->done = TRUE;
+  g_cond_broadcast(&dec->jobs_cond);
+  g_mutex_unlock(&dec->jobs_lock);
+}
+
+/* Push finished jobs in input order. With wait set, blocks until the queue
+ * holds less than limit jobs, limit 0 drains it completely. */
+static GstFlowReturn gst_gzdec_drain_jobs(GstGzdec *dec, gboolean wait, guint limit)
+{
+  GstFlowReturn flow = GST_FLOW_OK;
+  GzdecJob *job;
+
+  g_mutex_lock(&dec->jobs_lock);
+  while ((job = g_queue_peek_head(&dec->jobs)) != NULL)
+  {
+    if (!job->done)
+    {
+      if (!wait || g_queue_get_length(&dec->jobs) < MAX(limit, 1))
+        break;
+      /* FLUSH_STOP discards what is still queued */
+      if (g_atomic_int_get(&dec->flushing))
+      {
+        flow = GST_FLOW_FLUSHING;
+        break;
+      }
+      g_cond_wait(&dec->jobs_cond, &dec->jobs_lock);
+      continue;
+    }
+    g_queue_pop_head(&dec->jobs);
+    g_mutex_unlock(&dec->jobs_lock);
+
+    if (flow == GST_FLOW_OK)
+      flow = gst_gzdec_push_framed(dec, job->in, job->out);
+    else
+    {
+      gst_buffer_unref(job->in);
+      if (job->out)
+        gst_buffer_unref(job->out);
+    }
+    g_free(job);
+
+    g_mutex_lock(&dec->jobs_lock);
+  }
+  g_mutex_unlock(&dec->jobs_lock);
+
+  return flow;
+}
+
+/* Wait for the workers and drop everything still queued */
+static void gst_gzdec_discard_jobs(GstGzdec *dec)
+{
+  GzdecJob *job;
+
+  g_mutex_lock(&dec->jobs_lock);
+  while ((job = g_queue_peek_head(&dec->jobs)) != NULL)
+  {
+    if (!job->done)
+    {
+      g_cond_wait(&dec->jobs_cond, &dec->jobs_lock);
+      continue;
+    }
+    g_queue_pop_head(&dec->jobs);
+    gzdec_job_free(job);
+  }
+  g_mutex_unlock(&dec->jobs_lock);
+}
+
+static GstFlowReturn process_buffer_framed_async(GstGzdec *dec, GstBuffer *buf)
+{
+  g_return_val_if_fail(GST_IS_GZDEC(dec), GST_FLOW_ERROR);
+
+  GstMapInfo inmap = GST_MAP_INFO_INIT;
+  GzdecJob *job;
+
+  job = g_new0(GzdecJob, 1);
+  job->in = buf;
+  job->method = dec->method;
+  job->verify = dec->verify;
+  job->allocator = dec->allocator;
+  /* lazy output needs no worker, it still queues behind earlier objects */
+  if (dec->lazy && (job->out = gst_gzdec_wrap_lazy(dec, buf)) != NULL)
+  {
+    job->done = TRUE;
+    g_mutex_lock(&dec->jobs_lock);
+    g_queue_push_tail(&dec->jobs, job);
+    g_mutex_unlock(&dec->jobs_lock);
+    return gst_gzdec_drain_jobs(dec, TRUE, dec->max_in_flight);
+  }
+  gst_buffer_map(buf, &inmap, GST_MAP_READ);
+  job->predicted = gst_gzdec_predict_size(dec, inmap.data, inmap.size);
+  /* objects still in flight are not counted, pushing checks again */
+  job->limit = gst_gzdec_output_allowance(dec, dec->in_offset + inmap.size, dec->out_offset);
+  gst_buffer_unmap(buf, &inmap);
+
+  g_mutex_lock(&dec->jobs_lock);
+  g_queue_push_tail(&dec->jobs, job);
+  g_mutex_unlock(&dec->jobs_lock);
+  gst_gzdec_pool_client_push(dec->client, gzdec_worker_func, job, dec);
+
+  /* push what is ready, and block while too many objects are in flight */
+  return gst_gzdec_drain_jobs(dec, TRUE, dec->max_in_flight);
+}
+
+/* Decode stream input after whatever a flush left over, buf may be NULL */
+static GstFlowReturn gst_gzdec_process_stream(GstGzdec *dec, GstBuffer *buf)
+{
+  if (dec->leftover)
+  {
+    buf = buf ? gst_buffer_append(dec->leftover, buf) : dec->leftover;
+    dec->leftover = NULL;
+  }
+  if (buf == NULL)
+    return GST_FLOW_OK;
+  if (dec->latency_mode == LATENCY_LOW)
+    return process_buffer_low_latency(dec, buf);
+  return process_buffer_stream(dec, buf);
+}
 
 /* chain function
  * this function does the actual processing
@@ -444,18 +2105,274 @@ gst_gzdec_chain(GstPad *pad, GstObject *parent, GstBuffer *buf)
     GST_ELEMENT_ERROR(dec, LIBRARY, FAILED, (NULL), ("Decompressor not ready."));
     flow = GST_FLOW_FLUSHING;
   }
+  else if (dec->framing == FRAMING_PER_BUFFER)
+  {
+    if (dec->client)
+      flow = process_buffer_framed_async(dec, buf);
+    else
+      flow = process_buffer_framed(dec, buf);
+  }
   else
   {
-    if (dec->method == ZLIB)
+    flow = gst_gzdec_process_stream(dec, buf);
+  }
+  return flow;
+}
+
+static gboolean
+gst_gzdec_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
+{
+  GstGzdec *dec = GST_GZDEC(parent);
+
+  /* input a flush interrupted is still decoded before the end */
+  if (GST_EVENT_TYPE(event) == GST_EVENT_EOS)
+    gst_gzdec_process_stream(dec, NULL);
+
+  if (dec->client)
+  {
+    /* keep serialized events behind the data queued before them */
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+      gst_gzdec_discard_jobs(dec);
+    else if (GST_EVENT_IS_SERIALIZED(event))
+      gst_gzdec_drain_jobs(dec, TRUE, 0);
+  }
+
+  if (dec->latency_mode == LATENCY_LOW)
+  {
+    /* held back output goes out before anything that follows it */
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
     {
-      flow = process_buffer_zlib(dec, buf);
+      gst_gzdec_cancel_timeout(dec);
+      gst_gzdec_drop_pending(dec);
     }
-    else
+    else if (GST_EVENT_IS_SERIALIZED(event))
     {
-      flow = process_buffer_bzlib(dec, buf);
+      gst_gzdec_cancel_timeout(dec);
+      gst_gzdec_push_pending(dec);
     }
   }
-  return flow;
+
+  switch (GST_EVENT_TYPE(event))
+  {
+  case GST_EVENT_FLUSH_START:
+    gst_gzdec_set_flushing(dec);
+    break;
+  case GST_EVENT_STREAM_START:
+    /* a new file, its caps and digest are worked out again */
+    gst_gzdec_push_carry(dec);
+    gst_gzdec_reset_caps(dec);
+    gst_gzdec_reset_digest(dec);
+    break;
+  case GST_EVENT_FLUSH_STOP:
+    g_atomic_int_set(&dec->flushing, FALSE);
+    gst_buffer_replace(&dec->carry, NULL);
+    gst_gzdec_reset_digest(dec);
+    break;
+  case GST_EVENT_CAPS:
+    /* the compressed caps mean nothing downstream */
+    gst_event_unref(event);
+    return TRUE;
+  case GST_EVENT_SEGMENT:
+    if (dec->need_caps)
+    {
+      gst_event_replace(&dec->segment_event, event);
+      gst_event_unref(event);
+      return TRUE;
+    }
+    break;
+  case GST_EVENT_TAG:
+    /* like the segment, upstream tags must not overtake the caps */
+    if (dec->need_caps)
+    {
+      GstTagList *tags;
+
+      gst_event_parse_tag(event, &tags);
+      if (dec->pending_tags)
+        gst_tag_list_insert(dec->pending_tags, tags, GST_TAG_MERGE_KEEP);
+      else
+        dec->pending_tags = gst_tag_list_copy(tags);
+      gst_event_unref(event);
+      return TRUE;
+    }
+    break;
+  case GST_EVENT_GAP:
+    /* nothing was decoded, the caps and segment still have to go out */
+    gst_gzdec_negotiate(dec, NULL, 0);
+    break;
+  case GST_EVENT_EOS:
+    gst_gzdec_push_carry(dec);
+    gst_gzdec_negotiate(dec, NULL, 0);
+    gst_gzdec_finish_digest(dec);
+    break;
+  default:
+    break;
+  }
+
+  return gst_pad_event_default(pad, parent, event);
+}
+
+/* Read the gzip ISIZE trailer while the sink pad is briefly in pull mode */
+static void gst_gzdec_peek_isize(GstGzdec *dec)
+{
+  GstBuffer *trailer = NULL;
+  GstMapInfo map;
+  gint64 size;
+  guint64 duration;
+  gboolean gzip = FALSE;
+
+  if (!gst_pad_peer_query_duration(dec->sinkpad, GST_FORMAT_BYTES, &size) || size < 18)
+    return;
+  /* with method=auto this may be bzip2, which has no size trailer */
+  if (gst_pad_pull_range(dec->sinkpad, 0, 2, &trailer) != GST_FLOW_OK)
+    return;
+  if (gst_buffer_map(trailer, &map, GST_MAP_READ))
+  {
+    gzip = map.size == 2 && map.data[0] == 0x1f && map.data[1] == 0x8b;
+    gst_buffer_unmap(trailer, &map);
+  }
+  gst_buffer_unref(trailer);
+  trailer = NULL;
+  if (!gzip)
+    return;
+  if (gst_pad_pull_range(dec->sinkpad, size - 4, 4, &trailer) != GST_FLOW_OK)
+    return;
+
+  if (gst_buffer_map(trailer, &map, GST_MAP_READ) && map.size == 4)
+  {
+    duration = gzdec_core_gzip_isize(map.data, size);
+    if (duration)
+    {
+      dec->duration = duration;
+      GST_DEBUG_OBJECT(dec, "Trailer announces %" G_GUINT64_FORMAT " bytes", duration);
+    }
+    gst_buffer_unmap(trailer, &map);
+  }
+  gst_buffer_unref(trailer);
+}
+
+static gboolean
+gst_gzdec_sink_activate(GstPad *pad, GstObject *parent)
+{
+  GstGzdec *dec = GST_GZDEC(parent);
+  GstQuery *query;
+  gboolean pull = FALSE;
+
+  dec->duration = 0;
+
+  /* Decoding always runs in push mode, pull mode is only used to peek at
+   * the trailer of a single gzip stream when upstream is seekable */
+  query = gst_query_new_scheduling();
+  if ((dec->method == ZLIB || dec->method == AUTO) && dec->framing == FRAMING_STREAM &&
+      gst_pad_peer_query(pad, query))
+    pull = gst_query_has_scheduling_mode_with_flags(query, GST_PAD_MODE_PULL,
+                                                    GST_SCHEDULING_FLAG_SEEKABLE);
+  gst_query_unref(query);
+
+  if (pull && gst_pad_activate_mode(pad, GST_PAD_MODE_PULL, TRUE))
+  {
+    gst_gzdec_peek_isize(dec);
+    gst_pad_activate_mode(pad, GST_PAD_MODE_PULL, FALSE);
+  }
+
+  return gst_pad_activate_mode(pad, GST_PAD_MODE_PUSH, TRUE);
+}
+
+/* Best guess of the decoded size, 0 if there is nothing to go by */
+static guint64 gst_gzdec_get_duration(GstGzdec *dec)
+{
+  gint64 upstream;
+
+  if (dec->duration > 0)
+    return MAX(dec->duration, dec->out_offset);
+
+  /* scale upstream's size by the ratio seen so far */
+  if (dec->in_offset > 0 &&
+      gst_pad_peer_query_duration(dec->sinkpad, GST_FORMAT_BYTES, &upstream) && upstream > 0)
+    return MAX(gst_util_uint64_scale(upstream, dec->out_offset, dec->in_offset),
+               dec->out_offset);
+
+  return 0;
+}
+
+static gboolean
+gst_gzdec_src_query(GstPad *pad, GstObject *parent, GstQuery *query)
+{
+  GstGzdec *dec = GST_GZDEC(parent);
+  GstFormat format;
+  guint64 duration;
+  GstClockTime min, max;
+  gboolean live;
+
+  switch (GST_QUERY_TYPE(query))
+  {
+  case GST_QUERY_POSITION:
+    gst_query_parse_position(query, &format, NULL);
+    if (format != GST_FORMAT_BYTES)
+      break;
+    gst_query_set_position(query, GST_FORMAT_BYTES, dec->out_offset);
+    return TRUE;
+  case GST_QUERY_DURATION:
+    gst_query_parse_duration(query, &format, NULL);
+    if (format != GST_FORMAT_BYTES)
+      break;
+    duration = gst_gzdec_get_duration(dec);
+    if (duration == 0)
+      return FALSE;
+    gst_query_set_duration(query, GST_FORMAT_BYTES, duration);
+    return TRUE;
+  case GST_QUERY_LATENCY:
+    if (dec->latency_mode != LATENCY_LOW)
+      break;
+    if (!gst_pad_peer_query(dec->sinkpad, query))
+      return FALSE;
+    /* output can be held back for up to max-delay */
+    gst_query_parse_latency(query, &live, &min, &max);
+    min += dec->max_delay;
+    if (GST_CLOCK_TIME_IS_VALID(max))
+      max += dec->max_delay;
+    gst_query_set_latency(query, live, min, max);
+    return TRUE;
+  default:
+    break;
+  }
+
+  return gst_pad_query_default(pad, parent, query);
+}
+
+/* Lets decodebin find gzdec without the typefinders of gst-plugins-base */
+static void gzdec_type_find(GstTypeFind *tf, gpointer user_data)
+{
+  const guint8 *data = gst_type_find_peek(tf, 0, 10);
+
+  if (data == NULL)
+    return;
+
+  /* deflate method and no reserved flags */
+  if (data[0] == 0x1f && data[1] == 0x8b && data[2] == 8 && (data[3] & 0xe0) == 0)
+  {
+    gst_type_find_suggest_simple(tf, GST_TYPE_FIND_LIKELY, "application/x-gzip", NULL);
+  }
+  /* stream header, then the magic of the first block or of the end of an
+   * empty stream */
+  else if (data[0] == 'B' && data[1] == 'Z' && data[2] == 'h' && data[3] >= '1' && data[3] <= '9' &&
+           ((data[4] == 0x31 && data[5] == 0x41 && data[6] == 0x59 && data[7] == 0x26 &&
+             data[8] == 0x53 && data[9] == 0x59) ||
+            (data[4] == 0x17 && data[5] == 0x72 && data[6] == 0x45 && data[7] == 0x38 &&
+             data[8] == 0x50 && data[9] == 0x90)))
+  {
+    gst_type_find_suggest_simple(tf, GST_TYPE_FIND_MAXIMUM, "application/x-bzip", NULL);
+  }
+}
+
+static gboolean gzdec_type_find_register(GstPlugin *plugin)
+{
+  GstCaps *caps = gst_caps_from_string("application/x-gzip; application/x-bzip");
+  gboolean ret;
+
+  ret = gst_type_find_register(plugin, "gzdec-compressed", GST_RANK_MARGINAL, gzdec_type_find,
+                               "gz,tgz,bz2,tbz2", caps, NULL, NULL);
+  gst_caps_unref(caps);
+  return ret;
 }
 
 /* entry point to initialize the plug-in
@@ -471,8 +2388,14 @@ gzdec_init(GstPlugin *gzdec)
    */
   GST_DEBUG_CATEGORY_INIT(gst_gzdec_debug, "gzdec",
                           0, "Gzip decompress");
-
-  return GST_ELEMENT_REGISTER(gzdec, gzdec);
+  gst_tag_register(GZDEC_TAG_DIGEST, GST_TAG_FLAG_META, G_TYPE_STRING,
+                   "digest", "Digest of the decoded data as algorithm:hex", NULL);
+
+  return GST_ELEMENT_REGISTER(gzdec, gzdec) &&
+         GST_ELEMENT_REGISTER(gzdecsrc, gzdec) &&
+         GST_ELEMENT_REGISTER(zipdemux, gzdec) &&
+         GST_ELEMENT_REGISTER(tardemux, gzdec) &&
+         gzdec_type_find_register(gzdec);
 }
 /* gstreamer looks for this structure to register gzdecs
  *
@@ -53,15 +53,79 @@ G_BEGIN_DECLS
 
 #define GST_TYPE_GZDEC (gst_gzdec_get_type())
 #define GST_TYPE_METHOD (gst_method_get_type())
+#define GST_TYPE_FRAMING (gst_framing_get_type())
+#define GST_TYPE_VERIFY (gst_verify_get_type())
+#define GST_TYPE_LATENCY_MODE (gst_latency_mode_get_type())
+#define GST_TYPE_DIGEST (gst_digest_get_type())
+#define GST_TYPE_ALIGN (gst_align_get_type())
+#define GST_TYPE_ALLOCATOR_MODE (gst_allocator_mode_get_type())
 G_DECLARE_FINAL_TYPE (GstGzdec, gst_gzdec,
     GST, GZDEC, GstElement)
 
+GST_ELEMENT_REGISTER_DECLARE (gzdec);
+
+GType gst_method_get_type (void);
+GType gst_framing_get_type (void);
+GType gst_verify_get_type (void);
+GType gst_latency_mode_get_type (void);
+GType gst_digest_get_type (void);
+GType gst_align_get_type (void);
+GType gst_allocator_mode_get_type (void);
+
+/* algorithm:hex digest of the decoded stream, sent at EOS */
+#define GZDEC_TAG_DIGEST "gzdec-digest"
+
 // Enum to property Method
 typedef enum {
 	ZLIB,
-	BZLIB
+	BZLIB,
+	BZIP2,
+	AUTO
 } GstDecMethod;
 
+// Enum to property Framing
+typedef enum {
+	FRAMING_STREAM,
+	FRAMING_PER_BUFFER
+} GstDecFraming;
+
+// Enum to property Verify
+typedef enum {
+	VERIFY_NONE,
+	VERIFY_CRC32,
+	VERIFY_CRC32_FAST
+} GstDecVerify;
+
+// Enum to property LatencyMode
+typedef enum {
+	LATENCY_THROUGHPUT,
+	LATENCY_LOW
+} GstDecLatencyMode;
+
+// Enum to property Digest
+typedef enum {
+	DIGEST_NONE,
+	DIGEST_XXH3,
+	DIGEST_SHA256,
+	DIGEST_CRC32C
+} GstDecDigest;
+
+// Enum to property Align
+typedef enum {
+	ALIGN_NONE,
+	ALIGN_NEWLINE,
+	ALIGN_DELIMITER,
+	ALIGN_RECORD
+} GstDecAlign;
+
+// Enum to property Allocator
+typedef enum {
+	ALLOCATOR_SYSTEM,
+	ALLOCATOR_MEMFD,
+	ALLOCATOR_MEMFD_HUGETLB,
+	ALLOCATOR_LAZY
+} GstDecAllocator;
+
 
 G_END_DECLS
 
@@ -64,8 +64,7 @@
 #include <gst/gst.h>
 
 #include "gstgzdec0.1.h"
-#include <zlib.h>
-#include <bzlib.h>
+#include "gzdeccore.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_gzdec_debug);
 #define GST_CAT_DEFAULT gst_gzdec_debug
@@ -94,8 +93,7 @@ struct _GstGzdec
   gboolean silent;
   GstDecMethod method;
   gboolean ready;
-  z_stream stream;
-  bz_stream bz_stream;
+  GzdecCore *core;
 
   guint64 offset;
 
@@ -161,16 +159,8 @@ gst_gzdec_decompress_end(GstGzdec *dec)
   if (dec->ready)
   {
     GST_DEBUG_OBJECT(dec, "Finalize gzdec decompressing library");
-    if (dec->method == ZLIB)
-    {
-      inflateEnd(&dec->stream);
-      memset(&dec->stream, 0, sizeof(dec->stream));
-    }
-    else
-    {
-      BZ2_bzDecompressEnd(&dec->bz_stream);
-      memset(&dec->bz_stream, 0, sizeof(dec->bz_stream));
-    }
+    gzdec_core_free(dec->core);
+    dec->core = NULL;
     dec->ready = FALSE;
   }
 }
@@ -201,28 +191,13 @@ gst_gzdec_base_init (gpointer gclass)
 }
 static void gst_gzdec_decompress_init(GstGzdec *dec)
 {
-  gint ret;
   g_return_if_fail(GST_IS_GZDEC(dec));
   gst_gzdec_decompress_end(dec);
 
-  if (dec->method == ZLIB)
-  {
-    dec->stream.zalloc = Z_NULL;
-    dec->stream.zfree = Z_NULL;
-    dec->stream.opaque = Z_NULL;
-    dec->stream.avail_in = 0;
-    dec->stream.next_in = Z_NULL;
-    // MAX_WBITS + 16  to deflate (RFC 1952)
-    ret = inflateInit2(&dec->stream, MAX_WBITS + 16);
-  }
-  else
-  {
-    dec->bz_stream.bzalloc = NULL;
-    dec->bz_stream.bzfree = NULL;
-    dec->bz_stream.opaque = NULL;
-    ret = BZ2_bzDecompressInit(&dec->bz_stream, 0, 0);
-  }
-  dec->ready = TRUE;
+  dec->core = gzdec_core_new(dec->method == ZLIB ? GZDEC_CORE_GZIP : GZDEC_CORE_BZIP2,
+                             GZDEC_CORE_VERIFY_CRC32);
+  dec->offset = 0;
+  dec->ready = dec->core != NULL;
   return;
 }
 
@@ -321,109 +296,62 @@ gst_gzdec_get_property (GObject * object, guint prop_id,
 
 /* GstElement vmethod implementations */
 
-static GstFlowReturn process_buffer_zlib(GstGzdec *dec, GstBuffer *buf)
+static GstFlowReturn process_buffer(GstGzdec *dec, GstBuffer *buf)
 {
-  g_return_if_fail(GST_IS_GZDEC(dec));
-
-  
-
+  g_return_val_if_fail(GST_IS_GZDEC(dec), GST_FLOW_ERROR);
   GstFlowReturn flow = GST_FLOW_OK;
   GstBuffer *outbuf;
-  gint err;
+  gsize written;
 
-  dec->stream.next_in = (z_const gchar *) GST_BUFFER_DATA (buf);
-  dec->stream.avail_in = GST_BUFFER_SIZE (buf);
+  gzdec_core_feed (dec->core, GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf));
   do
   {
     /* Create the output buffer */
     flow = gst_pad_alloc_buffer (dec->srcpad, dec->offset,
             DEFAULT_DEC_SIZE,
             GST_PAD_CAPS (dec->srcpad), &outbuf);
-    /* Decode */
-    dec->stream.next_out = (gchar *) GST_BUFFER_DATA (outbuf);
-    dec->stream.avail_out = GST_BUFFER_SIZE (outbuf);
-    err = inflate(&dec->stream, Z_NO_FLUSH);
-    if ((err != Z_OK) && (err != Z_STREAM_END))
-    {
-      GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL), ("Failed to decompress data"));
-      gst_buffer_unref(outbuf);
-      flow = GST_FLOW_ERROR;
-      break;
-    }
-
-    if (dec->stream.avail_out >= GST_BUFFER_SIZE(outbuf))
-    {
-      gst_buffer_unref(outbuf);
-      break;
-    }
-
-    GST_BUFFER_SIZE (outbuf) -= dec->stream.avail_out;
-    GST_BUFFER_OFFSET (outbuf) = dec->stream.total_out - GST_BUFFER_SIZE (outbuf);
-    GST_DEBUG_OBJECT(dec, "Push data on src pad");
-
-    /* Push data */
-    flow = gst_pad_push(dec->srcpad, outbuf);
     if (flow != GST_FLOW_OK)
-    {
-      
       break;
-    }
-  } while (err != Z_STREAM_END);
-
-  gst_buffer_unref(buf);
-  return flow;
 
-}
-
-static GstFlowReturn process_buffer_bzlib(GstGzdec *dec, GstBuffer *buf)
-{
-  g_return_if_fail(GST_IS_GZDEC(dec));
-  GstFlowReturn flow = GST_FLOW_OK;
-  GstBuffer *outbuf;
-  gint err;
-
-  dec->bz_stream.next_in = (void *) GST_BUFFER_DATA (buf);
-  dec->bz_stream.avail_in = GST_BUFFER_SIZE (buf);
-
-  do
-  {
-    /* Create the output buffer */
-
-    flow = gst_pad_alloc_buffer (dec->srcpad, 0,
-            DEFAULT_DEC_SIZE,
-            GST_PAD_CAPS (dec->srcpad), &outbuf);
-
- 
     /* Decode */
-    dec->bz_stream.next_out = (void *) GST_BUFFER_DATA (outbuf);
-    dec->bz_stream.avail_out = GST_BUFFER_SIZE (outbuf);
-    err = BZ2_bzDecompress(&dec->bz_stream);
-
-    if ((err != BZ_OK) && (err != BZ_STREAM_END))
+    if (gzdec_core_read (dec->core, GST_BUFFER_DATA (outbuf),
+            GST_BUFFER_SIZE (outbuf), &written) == GZDEC_CORE_ERROR)
     {
-      GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL), ("Failed to decompress data"));
+      GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL),
+          ("Failed to decompress data: %s", gzdec_core_error (dec->core)));
       gst_gzdec_decompress_init(dec);
       gst_buffer_unref(outbuf);
       flow = GST_FLOW_ERROR;
       break;
     }
 
-    if (dec->bz_stream.avail_out >= GST_BUFFER_SIZE(outbuf))
+    if (written == 0)
     {
       gst_buffer_unref(outbuf);
+      /* a member ended or a header was consumed, keep going */
+      if (gzdec_core_input_left (dec->core) > 0)
+        continue;
       break;
     }
-    GST_BUFFER_SIZE (outbuf) -= dec->bz_stream.avail_out;
-    GST_BUFFER_OFFSET (outbuf) = dec->bz_stream.total_out_lo32 - GST_BUFFER_SIZE (outbuf);
+
+    GST_BUFFER_SIZE (outbuf) = written;
+    GST_BUFFER_OFFSET (outbuf) = dec->offset;
+    dec->offset += GST_BUFFER_SIZE (outbuf);
+    GST_BUFFER_OFFSET_END (outbuf) = dec->offset;
+    GST_DEBUG_OBJECT(dec, "Push data on src pad");
+
     /* Push data */
     flow = gst_pad_push(dec->srcpad, outbuf);
     if (flow != GST_FLOW_OK)
       break;
-  } while (err != BZ_STREAM_END);
+  } while (gzdec_core_input_left (dec->core) > 0 || written == DEFAULT_DEC_SIZE);
 
+  if (dec->core)
+    gzdec_core_feed (dec->core, NULL, 0);
   gst_buffer_unref(buf);
   return flow;
 }
+
 /* this function handles the link with other elements */
 static gboolean
 gst_gzdec_set_caps (GstPad * pad, GstCaps * caps)
@@ -447,21 +375,18 @@ gst_gzdec_chain (GstPad * pad, GstBuffer * buf)
   GstFlowReturn flow = GST_FLOW_OK;
   GstGzdec *dec;
   dec = GST_GZDEC (GST_OBJECT_PARENT (pad));
-  gst_gzdec_decompress_init(dec);
+  /* the decoder keeps its state across buffers, only rebuild it when the
+   * method changed since */
+  if (!dec->ready || gzdec_core_get_format (dec->core) !=
+      (dec->method == ZLIB ? GZDEC_CORE_GZIP : GZDEC_CORE_BZIP2))
+    gst_gzdec_decompress_init(dec);
   if (!dec->ready)
   {
     GST_ELEMENT_ERROR (GST_ELEMENT (dec), STREAM, FAILED, (NULL), (NULL));
   }
   else
   {
-    if (dec->method == ZLIB)
-    {
-      flow = process_buffer_zlib(dec, buf);
-    }
-    else
-    {
-      flow = process_buffer_bzlib(dec, buf);
-    }
+    flow = process_buffer(dec, buf);
   }
   return flow;
 }
@@ -0,0 +1,360 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/* Lazily decoded output.
+ *
+ * A GstGzdecLazyMemory holds a reference to a complete compressed gzip object
+ * and the size it decodes to (its ISIZE trailer). Nothing is inflated until
+ * the memory, or a share of it, is mapped or copied; the decoded bytes are
+ * then kept for every later map. Branches that only forward the buffer to
+ * storage or to a sink speaking Content-Encoding: gzip take the compressed
+ * object from the GstGzdecCompressedMeta instead and never pay for decoding.
+ * The memory is read-only, so mapping it for writing gets a decoded copy.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <string.h>
+#include "gstgzdeclazy.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_gzdec_lazy_debug);
+#define GST_CAT_DEFAULT gst_gzdec_lazy_debug
+
+struct _GstGzdecLazyAllocator
+{
+  GstAllocator parent;
+};
+
+typedef struct
+{
+  GstMemory mem;
+
+  /* only set on the memory that was wrapped, shares reach it through
+   * mem.parent */
+  GstBuffer *compressed;
+  GzdecCoreVerify verify;
+  GMutex lock;
+  guint8 *data;
+  gboolean failed;
+} GstGzdecLazyMemory;
+
+G_DEFINE_TYPE_WITH_CODE(GstGzdecLazyAllocator, gst_gzdec_lazy_allocator, GST_TYPE_ALLOCATOR,
+                        GST_DEBUG_CATEGORY_INIT(gst_gzdec_lazy_debug, "gzdeclazy", 0,
+                                                "lazily decoded output"));
+
+static GstGzdecLazyMemory *gzdec_lazy_root(GstMemory *mem)
+{
+  return (GstGzdecLazyMemory *)(mem->parent ? mem->parent : mem);
+}
+
+/* Inflate the whole object, with one spare byte to catch objects that
+ * decode to more than announced */
+static guint8 *gzdec_lazy_decode(GstGzdecLazyMemory *lazy, gsize size)
+{
+  GzdecCore *core;
+  GzdecCoreStatus status = GZDEC_CORE_OK;
+  GstMapInfo map;
+  guint8 *data;
+  gsize used = 0, written = 0;
+  gboolean ok;
+
+  if (!gst_buffer_map(lazy->compressed, &map, GST_MAP_READ))
+    return NULL;
+  core = gzdec_core_new(GZDEC_CORE_GZIP, lazy->verify);
+  if (core == NULL)
+  {
+    gst_buffer_unmap(lazy->compressed, &map);
+    return NULL;
+  }
+
+  data = g_malloc(size + 1);
+  gzdec_core_feed(core, map.data, map.size);
+  do
+  {
+    status = gzdec_core_read(core, data + used, size + 1 - used, &written);
+    used += written;
+  } while (status != GZDEC_CORE_ERROR && used <= size &&
+           (written > 0 || gzdec_core_input_left(core) > 0));
+  ok = status != GZDEC_CORE_ERROR && used == size && gzdec_core_complete(core);
+
+  if (!ok)
+    GST_ERROR("Lazy gzip object of %" G_GSIZE_FORMAT " bytes does not decode to the "
+              "%" G_GSIZE_FORMAT " bytes announced: %s", map.size, size,
+              status == GZDEC_CORE_ERROR ? gzdec_core_error(core) : "size mismatch");
+  gzdec_core_free(core);
+  gst_buffer_unmap(lazy->compressed, &map);
+
+  if (!ok)
+  {
+    g_free(data);
+    return NULL;
+  }
+  GST_LOG("Decoded %" G_GSIZE_FORMAT " bytes on first map", size);
+  return data;
+}
+
+static gpointer gzdec_lazy_map(GstMemory *mem, gsize maxsize, GstMapFlags flags)
+{
+  GstGzdecLazyMemory *root = gzdec_lazy_root(mem);
+  guint8 *data;
+
+  g_mutex_lock(&root->lock);
+  if (root->data == NULL && !root->failed)
+  {
+    root->data = gzdec_lazy_decode(root, root->mem.maxsize);
+    root->failed = root->data == NULL;
+  }
+  data = root->data;
+  g_mutex_unlock(&root->lock);
+  return data;
+}
+
+static void gzdec_lazy_unmap(GstMemory *mem)
+{
+}
+
+static GstMemory *gzdec_lazy_share(GstMemory *mem, gssize offset, gssize size)
+{
+  GstGzdecLazyMemory *sub;
+  GstMemory *parent = mem->parent ? mem->parent : mem;
+
+  if (size == -1)
+    size = mem->size - offset;
+
+  sub = g_new0(GstGzdecLazyMemory, 1);
+  gst_memory_init(GST_MEMORY_CAST(sub),
+                  GST_MINI_OBJECT_FLAGS(parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY,
+                  mem->allocator, parent, mem->maxsize, mem->align, mem->offset + offset, size);
+  g_mutex_init(&sub->lock);
+  return GST_MEMORY_CAST(sub);
+}
+
+static GstMemory *gzdec_lazy_copy(GstMemory *mem, gssize offset, gssize size)
+{
+  GstMemory *copy;
+  GstMapInfo src, dst;
+
+  if (size == -1)
+    size = mem->size > (gsize)offset ? mem->size - offset : 0;
+
+  if (!gst_memory_map(mem, &src, GST_MAP_READ))
+    return NULL;
+  copy = gst_allocator_alloc(NULL, size, NULL);
+  gst_memory_map(copy, &dst, GST_MAP_WRITE);
+  memcpy(dst.data, src.data + offset, size);
+  gst_memory_unmap(copy, &dst);
+  gst_memory_unmap(mem, &src);
+  return copy;
+}
+
+static gboolean gzdec_lazy_is_span(GstMemory *mem1, GstMemory *mem2, gsize *offset)
+{
+  return FALSE;
+}
+
+static GstMemory *gst_gzdec_lazy_allocator_alloc(GstAllocator *allocator, gsize size,
+                                                 GstAllocationParams *params)
+{
+  GST_WARNING_OBJECT(allocator, "Lazy memory can only wrap compressed data");
+  return NULL;
+}
+
+static void gst_gzdec_lazy_allocator_free(GstAllocator *allocator, GstMemory *mem)
+{
+  GstGzdecLazyMemory *lazy = (GstGzdecLazyMemory *)mem;
+
+  if (lazy->compressed)
+    gst_buffer_unref(lazy->compressed);
+  g_free(lazy->data);
+  g_mutex_clear(&lazy->lock);
+  g_free(lazy);
+}
+
+static void
+gst_gzdec_lazy_allocator_class_init(GstGzdecLazyAllocatorClass *klass)
+{
+  GstAllocatorClass *allocator_class = (GstAllocatorClass *)klass;
+
+  allocator_class->alloc = gst_gzdec_lazy_allocator_alloc;
+  allocator_class->free = gst_gzdec_lazy_allocator_free;
+}
+
+static void
+gst_gzdec_lazy_allocator_init(GstGzdecLazyAllocator *self)
+{
+  GstAllocator *allocator = GST_ALLOCATOR_CAST(self);
+
+  allocator->mem_type = GST_GZDEC_LAZY_MEMORY_TYPE;
+  allocator->mem_map = gzdec_lazy_map;
+  allocator->mem_unmap = gzdec_lazy_unmap;
+  allocator->mem_share = gzdec_lazy_share;
+  allocator->mem_copy = gzdec_lazy_copy;
+  allocator->mem_is_span = gzdec_lazy_is_span;
+  GST_OBJECT_FLAG_SET(self, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
+GstAllocator *gst_gzdec_lazy_allocator_new(void)
+{
+  GstGzdecLazyAllocator *self = g_object_new(GST_TYPE_GZDEC_LAZY_ALLOCATOR, NULL);
+
+  gst_object_ref_sink(self);
+  return GST_ALLOCATOR(self);
+}
+
+GstMemory *gst_gzdec_lazy_allocator_wrap(GstAllocator *allocator, GstBuffer *compressed,
+                                         gsize size, GzdecCoreVerify verify)
+{
+  GstGzdecLazyMemory *lazy;
+
+  g_return_val_if_fail(GST_IS_GZDEC_LAZY_ALLOCATOR(allocator), NULL);
+  g_return_val_if_fail(size > 0, NULL);
+
+  lazy = g_new0(GstGzdecLazyMemory, 1);
+  gst_memory_init(GST_MEMORY_CAST(lazy), GST_MEMORY_FLAG_READONLY, allocator, NULL,
+                  size, 0, 0, size);
+  lazy->compressed = gst_buffer_ref(compressed);
+  lazy->verify = verify;
+  g_mutex_init(&lazy->lock);
+  return GST_MEMORY_CAST(lazy);
+}
+
+gboolean gst_is_gzdec_lazy_memory(GstMemory *mem)
+{
+  return mem != NULL && mem->allocator != NULL &&
+         gst_memory_is_type(mem, GST_GZDEC_LAZY_MEMORY_TYPE);
+}
+
+gboolean gst_gzdec_lazy_memory_is_decoded(GstMemory *mem)
+{
+  GstGzdecLazyMemory *root;
+  gboolean decoded;
+
+  g_return_val_if_fail(gst_is_gzdec_lazy_memory(mem), FALSE);
+
+  root = gzdec_lazy_root(mem);
+  g_mutex_lock(&root->lock);
+  decoded = root->data != NULL;
+  g_mutex_unlock(&root->lock);
+  return decoded;
+}
+
+GType gst_gzdec_compressed_meta_api_get_type(void)
+{
+  static GType type = 0;
+  static const gchar *tags[] = {GST_META_TAG_MEMORY_STR, NULL};
+
+  if (g_once_init_enter(&type))
+  {
+    GType _type = gst_meta_api_type_register("GstGzdecCompressedMetaAPI", tags);
+    g_once_init_leave(&type, _type);
+  }
+  return type;
+}
+
+static gboolean gzdec_compressed_meta_init(GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+  GstGzdecCompressedMeta *cmeta = (GstGzdecCompressedMeta *)meta;
+
+  cmeta->compressed = NULL;
+  cmeta->encoding = NULL;
+  return TRUE;
+}
+
+static void gzdec_compressed_meta_free(GstMeta *meta, GstBuffer *buffer)
+{
+  GstGzdecCompressedMeta *cmeta = (GstGzdecCompressedMeta *)meta;
+
+  if (cmeta->compressed)
+    gst_buffer_unref(cmeta->compressed);
+}
+
+static gboolean gzdec_compressed_meta_transform(GstBuffer *dest, GstMeta *meta,
+                                                GstBuffer *buffer, GQuark type, gpointer data)
+{
+  GstGzdecCompressedMeta *cmeta = (GstGzdecCompressedMeta *)meta;
+  GstMetaTransformCopy *copy = data;
+
+  /* part of the output is not what the whole object decodes to */
+  if (GST_META_TRANSFORM_IS_COPY(type) && !copy->region)
+    gst_buffer_add_gzdec_compressed_meta(dest, cmeta->compressed, cmeta->encoding);
+  return TRUE;
+}
+
+const GstMetaInfo *gst_gzdec_compressed_meta_get_info(void)
+{
+  static const GstMetaInfo *info = NULL;
+
+  if (g_once_init_enter((GstMetaInfo **)&info))
+  {
+    const GstMetaInfo *meta = gst_meta_register(GST_GZDEC_COMPRESSED_META_API_TYPE,
+                                                "GstGzdecCompressedMeta",
+                                                sizeof(GstGzdecCompressedMeta),
+                                                gzdec_compressed_meta_init,
+                                                gzdec_compressed_meta_free,
+                                                gzdec_compressed_meta_transform);
+    g_once_init_leave((GstMetaInfo **)&info, (GstMetaInfo *)meta);
+  }
+  return info;
+}
+
+GstGzdecCompressedMeta *gst_buffer_add_gzdec_compressed_meta(GstBuffer *buffer,
+                                                             GstBuffer *compressed,
+                                                             const gchar *encoding)
+{
+  GstGzdecCompressedMeta *cmeta;
+
+  g_return_val_if_fail(GST_IS_BUFFER(buffer), NULL);
+  g_return_val_if_fail(GST_IS_BUFFER(compressed), NULL);
+
+  cmeta = (GstGzdecCompressedMeta *)gst_buffer_add_meta(buffer, GST_GZDEC_COMPRESSED_META_INFO,
+                                                        NULL);
+  cmeta->compressed = gst_buffer_ref(compressed);
+  cmeta->encoding = g_intern_string(encoding);
+  return cmeta;
+}
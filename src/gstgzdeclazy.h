@@ -0,0 +1,97 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_GZDEC_LAZY_H__
+#define __GST_GZDEC_LAZY_H__
+
+#include <gst/gst.h>
+#include "gzdeccore.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_GZDEC_LAZY_ALLOCATOR (gst_gzdec_lazy_allocator_get_type())
+G_DECLARE_FINAL_TYPE (GstGzdecLazyAllocator, gst_gzdec_lazy_allocator,
+    GST, GZDEC_LAZY_ALLOCATOR, GstAllocator)
+
+#define GST_GZDEC_LAZY_MEMORY_TYPE "GzdecLazyMemory"
+
+GstAllocator *gst_gzdec_lazy_allocator_new (void);
+
+/* Read-only memory of size bytes that decodes the gzip object in compressed
+ * the first time it is mapped. size must be what the object decodes to,
+ * mapping fails otherwise. Takes a reference to compressed. */
+GstMemory *gst_gzdec_lazy_allocator_wrap (GstAllocator * allocator,
+    GstBuffer * compressed, gsize size, GzdecCoreVerify verify);
+
+gboolean gst_is_gzdec_lazy_memory (GstMemory * mem);
+/* FALSE as long as nobody mapped or copied the memory */
+gboolean gst_gzdec_lazy_memory_is_decoded (GstMemory * mem);
+
+/* The compressed object a buffer of lazy memory decodes from, for consumers
+ * that can pass it on as it is (e.g. with Content-Encoding: gzip). The meta
+ * is tagged "memory" and only copied with the whole buffer. */
+typedef struct
+{
+  GstMeta meta;
+
+  GstBuffer *compressed;
+  /* "gzip" */
+  const gchar *encoding;
+} GstGzdecCompressedMeta;
+
+GType gst_gzdec_compressed_meta_api_get_type (void);
+#define GST_GZDEC_COMPRESSED_META_API_TYPE (gst_gzdec_compressed_meta_api_get_type())
+const GstMetaInfo *gst_gzdec_compressed_meta_get_info (void);
+#define GST_GZDEC_COMPRESSED_META_INFO (gst_gzdec_compressed_meta_get_info())
+
+#define gst_buffer_get_gzdec_compressed_meta(b) \
+    ((GstGzdecCompressedMeta *) gst_buffer_get_meta ((b), GST_GZDEC_COMPRESSED_META_API_TYPE))
+GstGzdecCompressedMeta *gst_buffer_add_gzdec_compressed_meta (GstBuffer * buffer,
+    GstBuffer * compressed, const gchar * encoding);
+
+G_END_DECLS
+
+#endif /* __GST_GZDEC_LAZY_H__ */
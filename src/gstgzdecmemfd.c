@@ -0,0 +1,197 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* memfd-backed GstFdMemory for decoded output.
+ *
+ * Every allocation creates a sealed-size memfd and wraps it in a GstFdMemory
+ * that stays mapped, so elements like shmsink or an fd-passing IPC sink can
+ * hand the decoded bytes to another process without copying them. Chunks of
+ * a huge page or more are advised for transparent huge pages. With hugetlb
+ * set the memfd comes from the hugetlbfs pool instead (MFD_HUGETLB), falling
+ * back to normal pages when the pool is empty or not configured.
+ */
+
+/* memfd_create() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include "gstgzdecmemfd.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_gzdec_memfd_debug);
+#define GST_CAT_DEFAULT gst_gzdec_memfd_debug
+/* the x86-64 and arm64 default huge page */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+struct _GstGzdecMemfdAllocator
+{
+  GstFdAllocator parent;
+
+  gboolean hugetlb;
+  gsize page_size;
+};
+
+G_DEFINE_TYPE_WITH_CODE(GstGzdecMemfdAllocator, gst_gzdec_memfd_allocator, GST_TYPE_FD_ALLOCATOR,
+                        GST_DEBUG_CATEGORY_INIT(gst_gzdec_memfd_debug, "gzdecmemfd", 0,
+                                                "memfd output allocator"));
+
+#ifdef HAVE_MEMFD_CREATE
+/* A memfd of size bytes wrapped in fd memory that is mapped already */
+static GstMemory *gzdec_memfd_alloc(GstGzdecMemfdAllocator *self, gsize size, gboolean hugetlb)
+{
+  GstMemory *mem;
+  GstMapInfo map;
+  gint fd;
+
+  fd = memfd_create("gzdec", MFD_CLOEXEC | MFD_ALLOW_SEALING | (hugetlb ? MFD_HUGETLB : 0));
+  if (fd < 0)
+    return NULL;
+  if (ftruncate(fd, size) < 0)
+  {
+    close(fd);
+    return NULL;
+  }
+  /* the receiving side may rely on the size staying put */
+  fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+  /* the fd now belongs to the memory and is closed with it */
+  mem = gst_fd_allocator_alloc(GST_ALLOCATOR(self), fd, size, GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+  if (mem == NULL)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  /* map once now, the mapping is kept for the lifetime of the memory. With
+   * hugetlb this is where an empty huge page pool shows. */
+  if (!gst_memory_map(mem, &map, GST_MAP_READWRITE))
+  {
+    gst_memory_unref(mem);
+    return NULL;
+  }
+  if (!hugetlb && size >= HUGE_PAGE_SIZE)
+    madvise(map.data, size, MADV_HUGEPAGE);
+  gst_memory_unmap(mem, &map);
+  return mem;
+}
+#endif
+
+static GstMemory *gst_gzdec_memfd_allocator_alloc(GstAllocator *allocator, gsize size,
+                                                  GstAllocationParams *params)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GstGzdecMemfdAllocator *self = GST_GZDEC_MEMFD_ALLOCATOR(allocator);
+  GstMemory *mem = NULL;
+  gsize maxsize, page;
+
+  maxsize = params->prefix + size + params->padding;
+  if (self->hugetlb)
+  {
+    maxsize = (maxsize + HUGE_PAGE_SIZE - 1) & ~(gsize)(HUGE_PAGE_SIZE - 1);
+    if ((mem = gzdec_memfd_alloc(self, maxsize, TRUE)) == NULL)
+    {
+      GST_WARNING_OBJECT(self, "No huge pages (%s), using normal pages", g_strerror(errno));
+      self->hugetlb = FALSE;
+    }
+  }
+  if (mem == NULL)
+  {
+    page = maxsize >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : self->page_size;
+    maxsize = (maxsize + page - 1) & ~(page - 1);
+    mem = gzdec_memfd_alloc(self, maxsize, FALSE);
+  }
+  if (mem == NULL)
+  {
+    GST_ERROR_OBJECT(self, "Failed to allocate a %" G_GSIZE_FORMAT " byte memfd: %s", maxsize,
+                     g_strerror(errno));
+    return NULL;
+  }
+
+  gst_memory_resize(mem, params->prefix, size);
+  GST_LOG_OBJECT(self, "%" G_GSIZE_FORMAT " byte memfd%s", maxsize,
+                 self->hugetlb ? " on huge pages" : "");
+  return mem;
+#else
+  return NULL;
+#endif
+}
+
+static void
+gst_gzdec_memfd_allocator_class_init(GstGzdecMemfdAllocatorClass *klass)
+{
+  GstAllocatorClass *allocator_class = (GstAllocatorClass *)klass;
+
+  allocator_class->alloc = gst_gzdec_memfd_allocator_alloc;
+}
+
+static void
+gst_gzdec_memfd_allocator_init(GstGzdecMemfdAllocator *self)
+{
+  self->page_size = sysconf(_SC_PAGESIZE);
+}
+
+GstAllocator *gst_gzdec_memfd_allocator_new(gboolean hugetlb)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GstGzdecMemfdAllocator *self = g_object_new(GST_TYPE_GZDEC_MEMFD_ALLOCATOR, NULL);
+
+  gst_object_ref_sink(self);
+  self->hugetlb = hugetlb;
+  return GST_ALLOCATOR(self);
+#else
+  return NULL;
+#endif
+}
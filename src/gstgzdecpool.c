@@ -0,0 +1,606 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Process-wide worker pool shared by all gzdec instances.
+ *
+ * Every element instance is a client with its own job queue. Clients with
+ * runnable jobs wait in the ready list of one shard, and a worker serves
+ * the clients of its own shard round robin, taking up to priority jobs per
+ * turn. A worker whose shard is empty steals from the other shards, so no
+ * thread idles while any instance has work queued.
+ */
+
+/* pthread_setaffinity_np() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include "gstgzdecpool.h"
+
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_gzdec_pool_debug);
+#define GST_CAT_DEFAULT gst_gzdec_pool_debug
+/* global thread cap, one per CPU if unset */
+#define MAX_THREADS_ENV "GZDEC_MAX_THREADS"
+/* pin workers to CPUs and place clients near the thread creating them */
+#define AFFINITY_ENV "GZDEC_AFFINITY"
+#define MAX_THREADS_LIMIT 1024
+
+enum
+{
+  PROP_0,
+  PROP_MAX_THREADS,
+  PROP_AFFINITY
+};
+
+typedef struct
+{
+  GMutex lock;
+  /* signalled whenever a job of a client in this shard finishes */
+  GCond cond;
+  /* clients with runnable jobs */
+  GQueue ready;
+} GzdecPoolShard;
+
+struct _GzdecPoolClient
+{
+  GstGzdecPool *pool;
+  GzdecPoolShard *shard;
+  GQueue jobs;
+  guint running;
+  /* 0 = no limit */
+  guint max_running;
+  /* jobs taken per round robin turn */
+  guint priority;
+  guint credit;
+  gboolean scheduled;
+};
+
+typedef struct
+{
+  GzdecPoolClient *client;
+  GFunc func;
+  gpointer data;
+  gpointer user_data;
+  /* jobs pushed through the GstTaskPool interface */
+  GstTaskPoolFunction task_func;
+  gboolean joinable;
+  gboolean done;
+} GzdecPoolWork;
+
+typedef struct
+{
+  GstGzdecPool *pool;
+  guint index;
+} GzdecPoolWorker;
+
+struct _GstGzdecPool
+{
+  GstTaskPool parent;
+
+  GzdecPoolShard *shards;
+  guint n_shards;
+  guint next_shard;
+
+  /* protects the fields below, idle workers wait on wake and workers
+   * above the thread cap on park, so no wakeup is spent on a parked one */
+  GMutex lock;
+  GCond wake;
+  GCond park;
+  /* clients in all ready lists */
+  gint ready;
+  guint n_threads;
+  guint max_threads;
+  gboolean affinity;
+
+  GzdecPoolClient *task_client;
+};
+
+#define gst_gzdec_pool_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstGzdecPool, gst_gzdec_pool, GST_TYPE_TASK_POOL,
+                        GST_DEBUG_CATEGORY_INIT(gst_gzdec_pool_debug, "gzdecpool", 0,
+                                                "Shared gzdec worker pool"));
+
+static void gst_gzdec_pool_set_property(GObject *object,
+                                        guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_gzdec_pool_get_property(GObject *object,
+                                        guint prop_id, GValue *value, GParamSpec *pspec);
+static gpointer gst_gzdec_pool_push(GstTaskPool *task_pool, GstTaskPoolFunction func,
+                                    gpointer user_data, GError **error);
+static void gst_gzdec_pool_join(GstTaskPool *task_pool, gpointer id);
+static void gst_gzdec_pool_dispose_handle(GstTaskPool *task_pool, gpointer id);
+
+/* One more job can run, called with the shard lock */
+static void gzdec_pool_wake(GstGzdecPool *pool)
+{
+  g_mutex_lock(&pool->lock);
+  g_cond_signal(&pool->wake);
+  g_mutex_unlock(&pool->lock);
+}
+
+/* Called with the shard lock */
+static void gzdec_pool_schedule(GzdecPoolClient *client)
+{
+  GstGzdecPool *pool = client->pool;
+
+  client->scheduled = TRUE;
+  client->credit = client->priority;
+  g_queue_push_tail(&client->shard->ready, client);
+
+  g_atomic_int_inc(&pool->ready);
+  gzdec_pool_wake(pool);
+}
+
+static gboolean gzdec_pool_client_runnable(GzdecPoolClient *client)
+{
+  return !g_queue_is_empty(&client->jobs) &&
+         (client->max_running == 0 || client->running < client->max_running);
+}
+
+/* Take a job from the home shard, or steal one from the others */
+static GzdecPoolWork *gzdec_pool_take(GstGzdecPool *pool, guint home)
+{
+  GzdecPoolShard *shard;
+  GzdecPoolClient *client;
+  GzdecPoolWork *work;
+  guint i;
+
+  for (i = 0; i < pool->n_shards; i++)
+  {
+    shard = &pool->shards[(home + i) % pool->n_shards];
+    g_mutex_lock(&shard->lock);
+    client = g_queue_peek_head(&shard->ready);
+    if (client == NULL)
+    {
+      g_mutex_unlock(&shard->lock);
+      continue;
+    }
+
+    work = g_queue_pop_head(&client->jobs);
+    client->running++;
+    client->credit--;
+    if (!gzdec_pool_client_runnable(client))
+    {
+      g_queue_pop_head(&shard->ready);
+      client->scheduled = FALSE;
+      g_atomic_int_add(&pool->ready, -1);
+    }
+    else
+    {
+      if (client->credit == 0)
+      {
+        /* turn used up, the next client goes first */
+        g_queue_push_tail(&shard->ready, g_queue_pop_head(&shard->ready));
+        client->credit = client->priority;
+      }
+      /* more queued, let another worker take the next one */
+      gzdec_pool_wake(pool);
+    }
+    g_mutex_unlock(&shard->lock);
+    return work;
+  }
+  return NULL;
+}
+
+static void gzdec_pool_run(GzdecPoolWork *work)
+{
+  GzdecPoolClient *client = work->client;
+  GzdecPoolShard *shard = client->shard;
+
+  if (work->task_func)
+    work->task_func(work->user_data);
+  else
+    work->func(work->data, work->user_data);
+
+  g_mutex_lock(&shard->lock);
+  client->running--;
+  if (!client->scheduled && gzdec_pool_client_runnable(client))
+    gzdec_pool_schedule(client);
+  if (work->joinable)
+    work->done = TRUE;
+  else
+    g_free(work);
+  g_cond_broadcast(&shard->cond);
+  g_mutex_unlock(&shard->lock);
+}
+
+static gpointer gzdec_pool_worker(gpointer data)
+{
+  GzdecPoolWorker *worker = data;
+  GstGzdecPool *pool = worker->pool;
+  guint index = worker->index;
+  GzdecPoolWork *work;
+
+  g_free(worker);
+
+#ifdef __linux__
+  if (pool->affinity)
+  {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(index % g_get_num_processors(), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#endif
+
+  while (TRUE)
+  {
+    /* workers above a lowered thread cap park here */
+    g_mutex_lock(&pool->lock);
+    while (index >= pool->max_threads || g_atomic_int_get(&pool->ready) <= 0)
+    {
+      if (index >= pool->max_threads)
+        g_cond_wait(&pool->park, &pool->lock);
+      else
+        g_cond_wait(&pool->wake, &pool->lock);
+    }
+    g_mutex_unlock(&pool->lock);
+
+    work = gzdec_pool_take(pool, index % pool->n_shards);
+    if (work)
+      gzdec_pool_run(work);
+    else
+      g_thread_yield();
+  }
+  return NULL;
+}
+
+/* Called with the pool lock */
+static void gzdec_pool_spawn_threads(GstGzdecPool *pool)
+{
+  GzdecPoolWorker *worker;
+  gchar *name;
+
+  while (pool->n_threads < pool->max_threads)
+  {
+    worker = g_new0(GzdecPoolWorker, 1);
+    worker->pool = pool;
+    worker->index = pool->n_threads++;
+    name = g_strdup_printf("gzdec-worker-%u", worker->index);
+    g_thread_unref(g_thread_new(name, gzdec_pool_worker, worker));
+    g_free(name);
+  }
+  /* parked workers may be back under the cap, idle ones above a lowered
+   * cap move over to park */
+  g_cond_broadcast(&pool->park);
+  g_cond_broadcast(&pool->wake);
+}
+
+static void
+gst_gzdec_pool_class_init(GstGzdecPoolClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *)klass;
+  GstTaskPoolClass *taskpool_class = (GstTaskPoolClass *)klass;
+
+  gobject_class->set_property = gst_gzdec_pool_set_property;
+  gobject_class->get_property = gst_gzdec_pool_get_property;
+
+  g_object_class_install_property(gobject_class, PROP_MAX_THREADS,
+                                  g_param_spec_uint("max-threads",
+                                                    "Max threads",
+                                                    "Worker threads shared by all gzdec instances "
+                                                    "(0 = GZDEC_MAX_THREADS or one per CPU)",
+                                                    0, MAX_THREADS_LIMIT, 0,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_AFFINITY,
+                                  g_param_spec_boolean("affinity",
+                                                       "Affinity",
+                                                       "Pin workers to CPUs and queue each instance's jobs "
+                                                       "near the CPU that created it",
+                                                       FALSE,
+                                                       (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  taskpool_class->push = gst_gzdec_pool_push;
+  taskpool_class->join = gst_gzdec_pool_join;
+  taskpool_class->dispose_handle = gst_gzdec_pool_dispose_handle;
+}
+
+/* What max-threads=0 stands for */
+static guint gzdec_pool_default_threads(GstGzdecPool *pool)
+{
+  const gchar *env = g_getenv(MAX_THREADS_ENV);
+
+  if (env && atoi(env) > 0)
+    return MIN(atoi(env), MAX_THREADS_LIMIT);
+  return MIN(pool->n_shards, MAX_THREADS_LIMIT);
+}
+
+static void
+gst_gzdec_pool_init(GstGzdecPool *pool)
+{
+  const gchar *env;
+  guint i;
+
+  pool->n_shards = g_get_num_processors();
+  pool->shards = g_new0(GzdecPoolShard, pool->n_shards);
+  for (i = 0; i < pool->n_shards; i++)
+  {
+    g_mutex_init(&pool->shards[i].lock);
+    g_cond_init(&pool->shards[i].cond);
+    g_queue_init(&pool->shards[i].ready);
+  }
+  g_mutex_init(&pool->lock);
+  g_cond_init(&pool->wake);
+  g_cond_init(&pool->park);
+
+  pool->max_threads = gzdec_pool_default_threads(pool);
+  env = g_getenv(AFFINITY_ENV);
+  pool->affinity = env && atoi(env) > 0;
+
+  GST_DEBUG_OBJECT(pool, "%u shards, up to %u threads", pool->n_shards, pool->max_threads);
+}
+
+static void
+gst_gzdec_pool_set_property(GObject *object, guint prop_id,
+                            const GValue *value, GParamSpec *pspec)
+{
+  GstGzdecPool *pool = GST_GZDEC_POOL(object);
+
+  switch (prop_id)
+  {
+  case PROP_MAX_THREADS:
+    gst_gzdec_pool_set_max_threads(pool, g_value_get_uint(value));
+    break;
+  case PROP_AFFINITY:
+    /* only affects workers started afterwards */
+    pool->affinity = g_value_get_boolean(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+gst_gzdec_pool_get_property(GObject *object, guint prop_id,
+                            GValue *value, GParamSpec *pspec)
+{
+  GstGzdecPool *pool = GST_GZDEC_POOL(object);
+
+  switch (prop_id)
+  {
+  case PROP_MAX_THREADS:
+    g_value_set_uint(value, gst_gzdec_pool_get_max_threads(pool));
+    break;
+  case PROP_AFFINITY:
+    g_value_set_boolean(value, pool->affinity);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+/* The pool lives as long as the process */
+GstGzdecPool *gst_gzdec_pool_get_default(void)
+{
+  static GstGzdecPool *pool = NULL;
+
+  if (g_once_init_enter(&pool))
+  {
+    GstGzdecPool *temp = g_object_new(GST_TYPE_GZDEC_POOL, NULL);
+
+    gst_object_ref_sink(temp);
+    GST_OBJECT_FLAG_SET(temp, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+    g_once_init_leave(&pool, temp);
+  }
+
+  return gst_object_ref(pool);
+}
+
+void gst_gzdec_pool_set_max_threads(GstGzdecPool *pool, guint max_threads)
+{
+  g_mutex_lock(&pool->lock);
+  if (max_threads == 0)
+    max_threads = gzdec_pool_default_threads(pool);
+  pool->max_threads = MIN(max_threads, MAX_THREADS_LIMIT);
+  /* threads are only started once someone uses the pool */
+  if (pool->n_threads > 0)
+    gzdec_pool_spawn_threads(pool);
+  g_mutex_unlock(&pool->lock);
+}
+
+guint gst_gzdec_pool_get_max_threads(GstGzdecPool *pool)
+{
+  guint max_threads;
+
+  g_mutex_lock(&pool->lock);
+  max_threads = pool->max_threads;
+  g_mutex_unlock(&pool->lock);
+  return max_threads;
+}
+
+/* max_running caps how many jobs of this client run at once (0 = no cap),
+ * priority is how many jobs it gets per turn against the other clients */
+GzdecPoolClient *gst_gzdec_pool_client_new(GstGzdecPool *pool, guint max_running,
+                                           guint priority)
+{
+  GzdecPoolClient *client = g_new0(GzdecPoolClient, 1);
+  guint shard = 0;
+  gint cpu = -1;
+
+  client->pool = gst_object_ref(pool);
+  client->max_running = max_running;
+  client->priority = MAX(priority, 1);
+  g_queue_init(&client->jobs);
+
+#ifdef __linux__
+  /* keep the jobs close to the CPU the streaming thread runs on, its
+   * input buffers are likely still in that cache */
+  if (pool->affinity)
+    cpu = sched_getcpu();
+#endif
+  if (cpu >= 0)
+    shard = cpu;
+  else
+    shard = g_atomic_int_add(&pool->next_shard, 1);
+  client->shard = &pool->shards[shard % pool->n_shards];
+
+  g_mutex_lock(&pool->lock);
+  gzdec_pool_spawn_threads(pool);
+  g_mutex_unlock(&pool->lock);
+  return client;
+}
+
+void gst_gzdec_pool_client_push(GzdecPoolClient *client, GFunc func,
+                                gpointer data, gpointer user_data)
+{
+  GzdecPoolWork *work = g_new0(GzdecPoolWork, 1);
+
+  work->client = client;
+  work->func = func;
+  work->data = data;
+  work->user_data = user_data;
+
+  g_mutex_lock(&client->shard->lock);
+  g_queue_push_tail(&client->jobs, work);
+  /* every queued job may get a worker of its own */
+  if (!client->scheduled && gzdec_pool_client_runnable(client))
+    gzdec_pool_schedule(client);
+  else if (client->scheduled)
+    gzdec_pool_wake(client->pool);
+  g_mutex_unlock(&client->shard->lock);
+}
+
+/* Waits for the client's queued and running jobs */
+void gst_gzdec_pool_client_free(GzdecPoolClient *client)
+{
+  GzdecPoolShard *shard = client->shard;
+
+  g_mutex_lock(&shard->lock);
+  while (client->running > 0 || !g_queue_is_empty(&client->jobs))
+    g_cond_wait(&shard->cond, &shard->lock);
+  if (client->scheduled)
+  {
+    g_queue_remove(&shard->ready, client);
+    g_atomic_int_add(&client->pool->ready, -1);
+  }
+  g_mutex_unlock(&shard->lock);
+
+  gst_object_unref(client->pool);
+  g_free(client);
+}
+
+/* GstTaskPool interface, for anything that wants these threads for a
+ * GstTask */
+static gpointer gst_gzdec_pool_push(GstTaskPool *task_pool, GstTaskPoolFunction func,
+                                    gpointer user_data, GError **error)
+{
+  GstGzdecPool *pool = GST_GZDEC_POOL(task_pool);
+  GzdecPoolWork *work;
+  GzdecPoolClient *client, *spare = NULL;
+
+  g_mutex_lock(&pool->lock);
+  if (pool->task_client == NULL)
+  {
+    g_mutex_unlock(&pool->lock);
+    client = gst_gzdec_pool_client_new(pool, 0, 1);
+    g_mutex_lock(&pool->lock);
+    if (pool->task_client == NULL)
+      pool->task_client = client;
+    else
+      spare = client;
+  }
+  client = pool->task_client;
+  g_mutex_unlock(&pool->lock);
+  /* lost the race, freeing takes the shard lock so it cannot happen under
+   * pool->lock (schedule takes them the other way round) */
+  if (spare)
+    gst_gzdec_pool_client_free(spare);
+
+  work = g_new0(GzdecPoolWork, 1);
+  work->client = client;
+  work->task_func = func;
+  work->user_data = user_data;
+  work->joinable = TRUE;
+
+  g_mutex_lock(&client->shard->lock);
+  g_queue_push_tail(&client->jobs, work);
+  if (!client->scheduled)
+    gzdec_pool_schedule(client);
+  else
+    gzdec_pool_wake(pool);
+  g_mutex_unlock(&client->shard->lock);
+  return work;
+}
+
+static void gst_gzdec_pool_join(GstTaskPool *task_pool, gpointer id)
+{
+  GzdecPoolWork *work = id;
+  GzdecPoolShard *shard = work->client->shard;
+
+  g_mutex_lock(&shard->lock);
+  while (!work->done)
+    g_cond_wait(&shard->cond, &shard->lock);
+  g_mutex_unlock(&shard->lock);
+  g_free(work);
+}
+
+static void gst_gzdec_pool_dispose_handle(GstTaskPool *task_pool, gpointer id)
+{
+  GzdecPoolWork *work = id;
+  GzdecPoolShard *shard = work->client->shard;
+  gboolean done;
+
+  g_mutex_lock(&shard->lock);
+  done = work->done;
+  /* the worker frees it once it ran */
+  work->joinable = FALSE;
+  g_mutex_unlock(&shard->lock);
+  if (done)
+    g_free(work);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Runs jobs through the shared gzdec pool and checks that one client's
+ * queue spreads over several workers, that a lowered thread cap is kept,
+ * and that every job runs, also while the cap moves. A lost wakeup shows
+ * up as a hang, which the alarm turns into a failure.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include "gstgzdecpool.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define N_JOBS 64
+#define N_THREADS 4
+#define TIMEOUT_S 60
+
+static gint running, peak, done;
+
+static void test_job(gpointer data, gpointer user_data)
+{
+  gint now = g_atomic_int_add(&running, 1) + 1;
+  gint old;
+
+  while ((old = g_atomic_int_get(&peak)) < now &&
+         !g_atomic_int_compare_and_exchange(&peak, old, now))
+    ;
+  g_usleep(5000);
+  g_atomic_int_add(&running, -1);
+  g_atomic_int_inc(&done);
+}
+
+/* Push jobs jobs on a fresh client, changing the cap to raise_to halfway
+ * when it is set, and wait for all of them */
+static void test_run(GstGzdecPool *pool, guint jobs, guint raise_to)
+{
+  GzdecPoolClient *client = gst_gzdec_pool_client_new(pool, 0, 1);
+  guint i;
+
+  g_atomic_int_set(&peak, 0);
+  g_atomic_int_set(&done, 0);
+  for (i = 0; i < jobs; i++)
+  {
+    if (raise_to && i == jobs / 2)
+      gst_gzdec_pool_set_max_threads(pool, raise_to);
+    gst_gzdec_pool_client_push(client, test_job, NULL, NULL);
+  }
+  gst_gzdec_pool_client_free(client);
+}
+
+int main(int argc, char **argv)
+{
+  GstGzdecPool *pool;
+  int ret = 0;
+
+  gst_init(&argc, &argv);
+  alarm(TIMEOUT_S);
+  pool = gst_gzdec_pool_get_default();
+
+  gst_gzdec_pool_set_max_threads(pool, N_THREADS);
+  test_run(pool, N_JOBS, 0);
+  printf("%d jobs on %d threads, up to %d at once\n", done, N_THREADS, peak);
+  if (done != N_JOBS || peak < 2)
+  {
+    fprintf(stderr, "one client's jobs did not spread over the workers\n");
+    ret = 1;
+  }
+
+  /* the workers above the cap park, wakeups must still reach the others */
+  gst_gzdec_pool_set_max_threads(pool, 2);
+  test_run(pool, N_JOBS, 0);
+  printf("%d jobs on 2 threads, up to %d at once\n", done, peak);
+  if (done != N_JOBS || peak > 2)
+  {
+    fprintf(stderr, "lowered thread cap not kept\n");
+    ret = 1;
+  }
+
+  gst_gzdec_pool_set_max_threads(pool, 1);
+  test_run(pool, N_JOBS, N_THREADS);
+  printf("%d jobs with the cap raised from 1 to %d\n", done, N_THREADS);
+  if (done != N_JOBS)
+  {
+    fprintf(stderr, "jobs lost while the cap was raised\n");
+    ret = 1;
+  }
+
+  gst_object_unref(pool);
+  return ret;
+}
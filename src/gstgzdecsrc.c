@@ -0,0 +1,852 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-gzdecsrc
+ *
+ * Reads a local .gz or .bz2 file and pushes the decompressed data. By
+ * default the file is memory-mapped and the decoder reads straight from the
+ * mapped pages, so no compressed byte is copied into a buffer first. With
+ * io-mode=uring, large O_DIRECT reads are kept in flight through io_uring so
+ * cold archives are read while the previous blocks decode, without filling
+ * the page cache.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 gzdecsrc location=/path/to/file.gz ! filesink location=/path/to/decompressed/file
+ * ]|
+ * </refsect2>
+ */
+
+/* O_DIRECT */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include "gstgzdec.h"
+#include "gstgzdecsrc.h"
+#include "gzdeccore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_gzdec_src_debug);
+#define GST_CAT_DEFAULT gst_gzdec_src_debug
+#define DEFAULT_BLOCKSIZE 65536
+#define DEFAULT_METHOD AUTO
+/* how far ahead of the decoder the kernel is asked to read */
+#define DEFAULT_READAHEAD (8 * 1024 * 1024)
+#define DEFAULT_IO_MODE IO_MODE_MMAP
+#define DEFAULT_QUEUE_DEPTH 4
+#define DEFAULT_READ_SIZE (1024 * 1024)
+/* O_DIRECT buffers, offsets and lengths are multiples of this */
+#define DIRECT_IO_ALIGN 4096
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_METHOD,
+  PROP_VERIFY,
+  PROP_READAHEAD,
+  PROP_IO_MODE,
+  PROP_QUEUE_DEPTH,
+  PROP_READ_SIZE
+};
+
+/* One read buffer, recycled for the next file offset once decoded */
+typedef struct
+{
+  guint8 *data;
+  guint64 offset;
+  gsize len;
+  gboolean busy;
+  gint res;
+} GzdecSrcBlock;
+
+struct _GstGzdecSrc
+{
+  GstPushSrc parent;
+
+  gchar *location;
+  GstDecMethod method;
+  GstDecVerify verify;
+  guint readahead;
+  GstDecIoMode io_mode;
+  guint queue_depth;
+  guint read_size;
+
+  gint fd;
+  gsize size;
+  /* IO_MODE_MMAP: the whole file */
+  guint8 *data;
+  /* end of the range already handed to madvise(MADV_WILLNEED) */
+  gsize advised;
+
+  /* IO_MODE_URING and IO_MODE_READ: blocks read in file order */
+  GstDecIoMode active_mode;
+  /* read-size, rounded up for O_DIRECT with io_uring */
+  guint block_size;
+  gint io_fd;
+  GzdecSrcBlock *blocks;
+  guint n_blocks;
+  guint head;
+  gboolean head_fed;
+  guint64 next_read;
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+  gboolean ring_ready;
+#endif
+
+  GzdecCore *core;
+  guint64 out_offset;
+  /* decoded size announced by the gzip trailer, 0 if unknown */
+  guint64 isize;
+};
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE("src",
+                                                                  GST_PAD_SRC,
+                                                                  GST_PAD_ALWAYS,
+                                                                  GST_STATIC_CAPS("ANY"));
+
+#define gst_gzdec_src_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstGzdecSrc, gst_gzdec_src, GST_TYPE_PUSH_SRC,
+                        GST_DEBUG_CATEGORY_INIT(gst_gzdec_src_debug, "gzdecsrc", 0,
+                                                "Memory-mapped gzip/bzip2 source"));
+
+GST_ELEMENT_REGISTER_DEFINE(gzdecsrc, "gzdecsrc", GST_RANK_NONE,
+                            GST_TYPE_GZDEC_SRC);
+
+static void gst_gzdec_src_set_property(GObject *object,
+                                       guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_gzdec_src_get_property(GObject *object,
+                                       guint prop_id, GValue *value, GParamSpec *pspec);
+static void gst_gzdec_src_finalize(GObject *object);
+static gboolean gst_gzdec_src_start(GstBaseSrc *basesrc);
+static gboolean gst_gzdec_src_stop(GstBaseSrc *basesrc);
+static gboolean gst_gzdec_src_query(GstBaseSrc *basesrc, GstQuery *query);
+static GstFlowReturn gst_gzdec_src_create(GstPushSrc *pushsrc, GstBuffer **buf);
+
+GType gst_io_mode_get_type(void)
+{
+  static GType io_mode_type = 0;
+
+  if (g_once_init_enter(&io_mode_type))
+  {
+    static GEnumValue io_mode_types[] = {
+        {IO_MODE_MMAP, "Memory-map the file and decode from the mapping",
+         "mmap"},
+        {IO_MODE_URING, "Asynchronous O_DIRECT reads through io_uring",
+         "uring"},
+        {IO_MODE_READ, "Buffered read() calls",
+         "read"},
+        {0, NULL, NULL},
+    };
+
+    GType temp = g_enum_register_static("GstDecIoMode",
+                                        io_mode_types);
+
+    g_once_init_leave(&io_mode_type, temp);
+  }
+
+  return io_mode_type;
+}
+
+static void
+gst_gzdec_src_class_init(GstGzdecSrcClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *)klass;
+  GstElementClass *gstelement_class = (GstElementClass *)klass;
+  GstBaseSrcClass *basesrc_class = (GstBaseSrcClass *)klass;
+  GstPushSrcClass *pushsrc_class = (GstPushSrcClass *)klass;
+
+  gobject_class->set_property = gst_gzdec_src_set_property;
+  gobject_class->get_property = gst_gzdec_src_get_property;
+  gobject_class->finalize = gst_gzdec_src_finalize;
+
+  g_object_class_install_property(gobject_class, PROP_LOCATION,
+                                  g_param_spec_string("location",
+                                                      "File Location",
+                                                      "Location of the compressed file to read",
+                                                      NULL,
+                                                      (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                       GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_METHOD,
+                                  g_param_spec_enum("method",
+                                                    "Method",
+                                                    "Decompress method",
+                                                    GST_TYPE_METHOD, DEFAULT_METHOD,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_VERIFY,
+                                  g_param_spec_enum("verify",
+                                                    "Verify",
+                                                    "How gzip checksums are verified",
+                                                    GST_TYPE_VERIFY, VERIFY_CRC32,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_READAHEAD,
+                                  g_param_spec_uint("readahead",
+                                                    "Read-ahead",
+                                                    "Bytes of the mapping the kernel is asked to "
+                                                    "read ahead of the decoder (0 = leave it to the kernel)",
+                                                    0, G_MAXINT, DEFAULT_READAHEAD,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_IO_MODE,
+                                  g_param_spec_enum("io-mode",
+                                                    "I/O mode",
+                                                    "How the compressed file is read",
+                                                    GST_TYPE_IO_MODE, DEFAULT_IO_MODE,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_QUEUE_DEPTH,
+                                  g_param_spec_uint("queue-depth",
+                                                    "Queue depth",
+                                                    "Reads kept in flight with io-mode=uring",
+                                                    1, 256, DEFAULT_QUEUE_DEPTH,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_READ_SIZE,
+                                  g_param_spec_uint("read-size",
+                                                    "Read size",
+                                                    "Bytes per read with io-mode=uring or read "
+                                                    "(rounded up to 4096 for O_DIRECT)",
+                                                    DIRECT_IO_ALIGN, 256 * 1024 * 1024, DEFAULT_READ_SIZE,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+
+  gst_element_class_set_details_simple(gstelement_class,
+                                       "Gzip decompressing file source",
+                                       "Source/File",
+                                       "Memory-maps a .gz or .bz2 file and pushes its decompressed contents",
+                                       "Lenin Torres <<ttvleninn@gmail.com>>");
+
+  gst_element_class_add_pad_template(gstelement_class,
+                                     gst_static_pad_template_get(&src_factory));
+
+  basesrc_class->start = GST_DEBUG_FUNCPTR(gst_gzdec_src_start);
+  basesrc_class->stop = GST_DEBUG_FUNCPTR(gst_gzdec_src_stop);
+  basesrc_class->query = GST_DEBUG_FUNCPTR(gst_gzdec_src_query);
+  pushsrc_class->create = GST_DEBUG_FUNCPTR(gst_gzdec_src_create);
+}
+
+static void
+gst_gzdec_src_init(GstGzdecSrc *src)
+{
+  src->location = NULL;
+  src->method = DEFAULT_METHOD;
+  src->verify = VERIFY_CRC32;
+  src->readahead = DEFAULT_READAHEAD;
+  src->io_mode = DEFAULT_IO_MODE;
+  src->queue_depth = DEFAULT_QUEUE_DEPTH;
+  src->read_size = DEFAULT_READ_SIZE;
+  src->fd = -1;
+  src->io_fd = -1;
+  src->data = NULL;
+  src->blocks = NULL;
+  src->core = NULL;
+  gst_base_src_set_blocksize(GST_BASE_SRC(src), DEFAULT_BLOCKSIZE);
+  gst_base_src_set_format(GST_BASE_SRC(src), GST_FORMAT_BYTES);
+}
+
+static void
+gst_gzdec_src_finalize(GObject *object)
+{
+  GstGzdecSrc *src = GST_GZDEC_SRC(object);
+
+  g_free(src->location);
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void
+gst_gzdec_src_set_property(GObject *object, guint prop_id,
+                           const GValue *value, GParamSpec *pspec)
+{
+  GstGzdecSrc *src = GST_GZDEC_SRC(object);
+
+  switch (prop_id)
+  {
+  case PROP_LOCATION:
+    g_free(src->location);
+    src->location = g_value_dup_string(value);
+    break;
+  case PROP_METHOD:
+    src->method = g_value_get_enum(value);
+    break;
+  case PROP_VERIFY:
+    src->verify = g_value_get_enum(value);
+    break;
+  case PROP_READAHEAD:
+    src->readahead = g_value_get_uint(value);
+    break;
+  case PROP_IO_MODE:
+    src->io_mode = g_value_get_enum(value);
+    break;
+  case PROP_QUEUE_DEPTH:
+    src->queue_depth = g_value_get_uint(value);
+    break;
+  case PROP_READ_SIZE:
+    src->read_size = g_value_get_uint(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+gst_gzdec_src_get_property(GObject *object, guint prop_id,
+                           GValue *value, GParamSpec *pspec)
+{
+  GstGzdecSrc *src = GST_GZDEC_SRC(object);
+
+  switch (prop_id)
+  {
+  case PROP_LOCATION:
+    g_value_set_string(value, src->location);
+    break;
+  case PROP_METHOD:
+    g_value_set_enum(value, src->method);
+    break;
+  case PROP_VERIFY:
+    g_value_set_enum(value, src->verify);
+    break;
+  case PROP_READAHEAD:
+    g_value_set_uint(value, src->readahead);
+    break;
+  case PROP_IO_MODE:
+    g_value_set_enum(value, src->io_mode);
+    break;
+  case PROP_QUEUE_DEPTH:
+    g_value_set_uint(value, src->queue_depth);
+    break;
+  case PROP_READ_SIZE:
+    g_value_set_uint(value, src->read_size);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+/* The whole file is visible, so the gzip ISIZE trailer can be read before
+ * decoding starts */
+static void gst_gzdec_src_read_isize(GstGzdecSrc *src)
+{
+  guint8 magic[2], trailer[4];
+  guint64 isize;
+
+  src->isize = 0;
+  if ((src->method != ZLIB && src->method != AUTO) || src->size < 18)
+    return;
+  if (pread(src->fd, magic, 2, 0) != 2 || magic[0] != 0x1f || magic[1] != 0x8b ||
+      pread(src->fd, trailer, 4, src->size - 4) != 4)
+    return;
+
+  isize = gzdec_core_gzip_isize(trailer, src->size);
+  if (isize == 0)
+    return;
+
+  src->isize = isize;
+  GST_DEBUG_OBJECT(src, "Trailer announces %" G_GUINT64_FORMAT " bytes", isize);
+}
+
+/* Tear down the queue of blocks, the file itself stays open */
+static void gst_gzdec_src_release_io(GstGzdecSrc *src)
+{
+  guint i;
+#ifdef HAVE_LIBURING
+  struct io_uring_cqe *cqe;
+  GzdecSrcBlock *block;
+
+  if (src->ring_ready)
+  {
+    /* file reads cannot be cancelled, let them land before the blocks go */
+    for (i = 0; i < src->n_blocks; i++)
+    {
+      while (src->blocks[i].busy && io_uring_wait_cqe(&src->ring, &cqe) >= 0)
+      {
+        block = io_uring_cqe_get_data(cqe);
+        block->busy = FALSE;
+        io_uring_cqe_seen(&src->ring, cqe);
+      }
+    }
+    io_uring_queue_exit(&src->ring);
+    src->ring_ready = FALSE;
+  }
+#endif
+  if (src->blocks)
+  {
+    for (i = 0; i < src->n_blocks; i++)
+      free(src->blocks[i].data);
+    g_free(src->blocks);
+    src->blocks = NULL;
+  }
+  if (src->io_fd >= 0)
+    close(src->io_fd);
+  src->io_fd = -1;
+}
+
+static gboolean gst_gzdec_src_map(GstGzdecSrc *src)
+{
+  src->data = mmap(NULL, src->size, PROT_READ, MAP_SHARED, src->fd, 0);
+  if (src->data == MAP_FAILED)
+  {
+    src->data = NULL;
+    GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ, (NULL),
+                      ("Could not map \"%s\": %s", src->location, g_strerror(errno)));
+    return FALSE;
+  }
+  /* the decoder walks the file once from start to end */
+  madvise(src->data, src->size, MADV_SEQUENTIAL);
+  src->advised = 0;
+  /* the decoder reads straight from the mapping */
+  gzdec_core_feed(src->core, src->data, src->size);
+  return TRUE;
+}
+
+static gboolean gst_gzdec_src_alloc_blocks(GstGzdecSrc *src, guint n_blocks, gsize len)
+{
+  guint i;
+
+  src->blocks = g_new0(GzdecSrcBlock, n_blocks);
+  src->n_blocks = n_blocks;
+  for (i = 0; i < n_blocks; i++)
+  {
+    if (posix_memalign((void **)&src->blocks[i].data, DIRECT_IO_ALIGN, len) != 0)
+      return FALSE;
+    src->blocks[i].len = len;
+  }
+  src->head = 0;
+  src->head_fed = FALSE;
+  src->next_read = 0;
+  return TRUE;
+}
+
+#ifdef HAVE_LIBURING
+static void gst_gzdec_src_submit(GstGzdecSrc *src, GzdecSrcBlock *block)
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&src->ring);
+
+  block->offset = src->next_read;
+  block->busy = TRUE;
+  io_uring_prep_read(sqe, src->io_fd, block->data, src->block_size, block->offset);
+  io_uring_sqe_set_data(sqe, block);
+  src->next_read += src->block_size;
+}
+
+/* Put the whole queue in flight, falls back to buffered reads when the
+ * kernel has no io_uring */
+static gboolean gst_gzdec_src_start_uring(GstGzdecSrc *src)
+{
+  gint ret;
+  guint i;
+
+  src->block_size = GST_ROUND_UP_N(src->read_size, DIRECT_IO_ALIGN);
+  ret = io_uring_queue_init(src->queue_depth, &src->ring, 0);
+  if (ret < 0)
+  {
+    GST_WARNING_OBJECT(src, "io_uring unavailable (%s), using buffered reads", g_strerror(-ret));
+    return FALSE;
+  }
+  src->ring_ready = TRUE;
+
+  /* bypass the page cache, the archive is read once */
+  src->io_fd = open(src->location, O_RDONLY | O_CLOEXEC | O_DIRECT);
+  if (src->io_fd < 0)
+  {
+    GST_DEBUG_OBJECT(src, "O_DIRECT refused (%s), reading through the page cache",
+                     g_strerror(errno));
+    src->io_fd = dup(src->fd);
+  }
+
+  if (!gst_gzdec_src_alloc_blocks(src, src->queue_depth, src->block_size))
+    return FALSE;
+  for (i = 0; i < src->n_blocks && src->next_read < src->size; i++)
+    gst_gzdec_src_submit(src, &src->blocks[i]);
+  io_uring_submit(&src->ring);
+
+  GST_DEBUG_OBJECT(src, "%u reads of %u bytes in flight", src->n_blocks, src->block_size);
+  return TRUE;
+}
+
+/* Wait until the head block has landed */
+static GstFlowReturn gst_gzdec_src_wait_uring(GstGzdecSrc *src, GzdecSrcBlock *head)
+{
+  struct io_uring_cqe *cqe;
+  GzdecSrcBlock *block;
+  gint ret;
+
+  while (head->busy)
+  {
+    ret = io_uring_wait_cqe(&src->ring, &cqe);
+    if (ret == -EINTR)
+      continue;
+    if (ret < 0)
+    {
+      GST_ELEMENT_ERROR(src, RESOURCE, READ, (NULL),
+                        ("io_uring wait failed: %s", g_strerror(-ret)));
+      return GST_FLOW_ERROR;
+    }
+    /* completions may arrive out of order */
+    block = io_uring_cqe_get_data(cqe);
+    block->res = cqe->res;
+    block->busy = FALSE;
+    io_uring_cqe_seen(&src->ring, cqe);
+  }
+  return GST_FLOW_OK;
+}
+#endif
+
+static GstFlowReturn gst_gzdec_src_read_block(GstGzdecSrc *src, GzdecSrcBlock *block)
+{
+  gssize ret;
+
+  do
+    ret = pread(src->io_fd, block->data, block->len, src->next_read);
+  while (ret < 0 && errno == EINTR);
+
+  block->offset = src->next_read;
+  block->res = ret < 0 ? -errno : ret;
+  src->next_read += MAX(ret, 0);
+  return GST_FLOW_OK;
+}
+
+/* Hand the next block of the file to the decoder. The previous one has
+ * been decoded completely, so it goes back into the queue first. */
+static GstFlowReturn gst_gzdec_src_next_block(GstGzdecSrc *src)
+{
+  GzdecSrcBlock *block;
+  GstFlowReturn flow;
+
+  block = &src->blocks[src->head];
+  if (src->head_fed)
+  {
+    src->head_fed = FALSE;
+    if (src->active_mode == IO_MODE_READ)
+    {
+      /* the page cache would only keep what has been decoded already */
+      posix_fadvise(src->io_fd, block->offset, block->res, POSIX_FADV_DONTNEED);
+    }
+#ifdef HAVE_LIBURING
+    else
+    {
+      if (src->next_read < src->size)
+      {
+        gst_gzdec_src_submit(src, block);
+        io_uring_submit(&src->ring);
+      }
+      else
+      {
+        /* nothing left to read into it */
+        block->res = 0;
+      }
+      src->head = (src->head + 1) % src->n_blocks;
+      block = &src->blocks[src->head];
+    }
+#endif
+  }
+
+#ifdef HAVE_LIBURING
+  if (src->active_mode == IO_MODE_URING)
+  {
+    if (!block->busy && block->res == 0)
+      return GST_FLOW_EOS;
+    flow = gst_gzdec_src_wait_uring(src, block);
+    /* later reads are already queued, a hole here cannot be filled */
+    if (flow == GST_FLOW_OK && block->res >= 0 && block->res < (gint)src->block_size &&
+        block->offset + block->res < src->size)
+    {
+      GST_ELEMENT_ERROR(src, RESOURCE, READ, (NULL),
+                        ("Short read from \"%s\" at %" G_GUINT64_FORMAT, src->location,
+                         block->offset));
+      return GST_FLOW_ERROR;
+    }
+  }
+  else
+#endif
+  {
+    if (src->next_read >= src->size)
+      return GST_FLOW_EOS;
+    flow = gst_gzdec_src_read_block(src, block);
+  }
+  if (flow != GST_FLOW_OK)
+    return flow;
+
+  if (block->res <= 0)
+  {
+    if (block->res == 0)
+      return GST_FLOW_EOS;
+    GST_ELEMENT_ERROR(src, RESOURCE, READ, (NULL),
+                      ("Could not read \"%s\": %s", src->location, g_strerror(-block->res)));
+    return GST_FLOW_ERROR;
+  }
+
+  gzdec_core_feed(src->core, block->data, block->res);
+  src->head_fed = TRUE;
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_gzdec_src_start(GstBaseSrc *basesrc)
+{
+  GstGzdecSrc *src = GST_GZDEC_SRC(basesrc);
+  struct stat st;
+
+  if (src->location == NULL || src->location[0] == '\0')
+  {
+    GST_ELEMENT_ERROR(src, RESOURCE, NOT_FOUND, ("No file name specified for reading."), (NULL));
+    return FALSE;
+  }
+
+  src->fd = open(src->location, O_RDONLY | O_CLOEXEC);
+  if (src->fd < 0)
+  {
+    GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ, (NULL),
+                      ("Could not open \"%s\": %s", src->location, g_strerror(errno)));
+    return FALSE;
+  }
+  if (fstat(src->fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+  {
+    GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ, (NULL),
+                      ("\"%s\" is not a non-empty regular file", src->location));
+    goto fail;
+  }
+  src->size = st.st_size;
+
+  src->core = gzdec_core_new(src->method == ZLIB    ? GZDEC_CORE_GZIP
+                             : src->method == BZIP2 ? GZDEC_CORE_BZIP2_BUILTIN
+                             : src->method == AUTO  ? GZDEC_CORE_AUTO
+                                                    : GZDEC_CORE_BZIP2,
+                             src->verify == VERIFY_NONE        ? GZDEC_CORE_VERIFY_NONE
+                             : src->verify == VERIFY_CRC32_FAST ? GZDEC_CORE_VERIFY_CRC32_FAST
+                                                                : GZDEC_CORE_VERIFY_CRC32);
+  if (src->core == NULL)
+  {
+    GST_ELEMENT_ERROR(src, LIBRARY, INIT, (NULL), ("Failed to create the decoder"));
+    goto fail;
+  }
+  src->out_offset = 0;
+  gst_gzdec_src_read_isize(src);
+
+  src->active_mode = src->io_mode;
+  src->block_size = src->read_size;
+  if (src->active_mode == IO_MODE_URING)
+  {
+#ifdef HAVE_LIBURING
+    if (!gst_gzdec_src_start_uring(src))
+    {
+      gst_gzdec_src_release_io(src);
+      src->active_mode = IO_MODE_READ;
+      src->block_size = src->read_size;
+    }
+#else
+    GST_WARNING_OBJECT(src, "Built without io_uring support, using buffered reads");
+    src->active_mode = IO_MODE_READ;
+#endif
+  }
+
+  switch (src->active_mode)
+  {
+  case IO_MODE_MMAP:
+    if (!gst_gzdec_src_map(src))
+      goto fail;
+    break;
+  case IO_MODE_READ:
+    src->io_fd = dup(src->fd);
+    posix_fadvise(src->io_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (!gst_gzdec_src_alloc_blocks(src, 1, src->block_size))
+      goto fail;
+    break;
+  default:
+    break;
+  }
+
+  GST_DEBUG_OBJECT(src, "Reading %" G_GSIZE_FORMAT " bytes of %s", src->size, src->location);
+  return TRUE;
+
+fail:
+  gst_gzdec_src_stop(basesrc);
+  return FALSE;
+}
+
+static gboolean
+gst_gzdec_src_stop(GstBaseSrc *basesrc)
+{
+  GstGzdecSrc *src = GST_GZDEC_SRC(basesrc);
+
+  gst_gzdec_src_release_io(src);
+  gzdec_core_free(src->core);
+  src->core = NULL;
+  if (src->data)
+    munmap(src->data, src->size);
+  src->data = NULL;
+  if (src->fd >= 0)
+    close(src->fd);
+  src->fd = -1;
+  return TRUE;
+}
+
+/* Ask the kernel for the next window before the decoder gets there */
+static void gst_gzdec_src_advise(GstGzdecSrc *src, gsize position)
+{
+  gsize page = sysconf(_SC_PAGESIZE);
+  gsize start, end;
+
+  if (src->readahead == 0 || src->advised >= src->size ||
+      position + src->readahead / 2 < src->advised)
+    return;
+
+  start = MAX(src->advised, position) & ~(page - 1);
+  end = MIN(position + src->readahead, src->size);
+  if (end > start)
+    madvise(src->data + start, end - start, MADV_WILLNEED);
+  src->advised = end;
+}
+
+static GstFlowReturn
+gst_gzdec_src_create(GstPushSrc *pushsrc, GstBuffer **buf)
+{
+  GstGzdecSrc *src = GST_GZDEC_SRC(pushsrc);
+  GstBuffer *outbuf;
+  GstMapInfo outmap;
+  GzdecCoreStatus status = GZDEC_CORE_OK;
+  GstFlowReturn flow = GST_FLOW_OK;
+  gsize written, total = 0;
+
+  outbuf = gst_buffer_new_and_alloc(gst_base_src_get_blocksize(GST_BASE_SRC(src)));
+  gst_buffer_map(outbuf, &outmap, GST_MAP_WRITE);
+
+  /* fill the whole buffer, stepping over member and block boundaries */
+  while (total < outmap.size)
+  {
+    if (gzdec_core_input_left(src->core) == 0)
+    {
+      if (src->active_mode == IO_MODE_MMAP)
+        break;
+      if ((flow = gst_gzdec_src_next_block(src)) != GST_FLOW_OK)
+        break;
+    }
+    if (src->active_mode == IO_MODE_MMAP)
+      gst_gzdec_src_advise(src, src->size - gzdec_core_input_left(src->core));
+    status = gzdec_core_read(src->core, outmap.data + total, outmap.size - total, &written);
+    total += written;
+    if (status == GZDEC_CORE_ERROR)
+      break;
+  }
+  gst_buffer_unmap(outbuf, &outmap);
+
+  if (flow == GST_FLOW_ERROR)
+  {
+    gst_buffer_unref(outbuf);
+    return flow;
+  }
+  if (status == GZDEC_CORE_ERROR)
+  {
+    GST_ELEMENT_ERROR(src, STREAM, DECODE, (NULL),
+                      ("Failed to decompress data: %s", gzdec_core_error(src->core)));
+    gst_buffer_unref(outbuf);
+    return GST_FLOW_ERROR;
+  }
+
+  if (total == 0)
+  {
+    gst_buffer_unref(outbuf);
+    if (!gzdec_core_complete(src->core))
+    {
+      GST_ELEMENT_ERROR(src, STREAM, DECODE, (NULL), ("Compressed file is truncated"));
+      return GST_FLOW_ERROR;
+    }
+    GST_DEBUG_OBJECT(src, "End of file");
+    return GST_FLOW_EOS;
+  }
+
+  gst_buffer_resize(outbuf, 0, total);
+  GST_BUFFER_OFFSET(outbuf) = src->out_offset;
+  src->out_offset += total;
+  GST_BUFFER_OFFSET_END(outbuf) = src->out_offset;
+  *buf = outbuf;
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_gzdec_src_query(GstBaseSrc *basesrc, GstQuery *query)
+{
+  GstGzdecSrc *src = GST_GZDEC_SRC(basesrc);
+  GstFormat format;
+
+  switch (GST_QUERY_TYPE(query))
+  {
+  case GST_QUERY_DURATION:
+    /* the decoded size, not the size of the file */
+    gst_query_parse_duration(query, &format, NULL);
+    if (format != GST_FORMAT_BYTES)
+      break;
+    if (src->isize == 0)
+      return FALSE;
+    gst_query_set_duration(query, GST_FORMAT_BYTES, MAX(src->isize, src->out_offset));
+    return TRUE;
+  default:
+    break;
+  }
+
+  return GST_BASE_SRC_CLASS(parent_class)->query(basesrc, query);
+}
@@ -0,0 +1,737 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-tardemux
+ *
+ * Splits a tar stream into its members as it arrives, typically right
+ * behind gzdec. ustar, pax and GNU long name headers are parsed
+ * incrementally, and every regular file member is pushed on its own
+ * sometimes pad, followed by EOS. Payloads are pushed as sub-buffers of the
+ * input buffers, nothing is copied. Members that do not match the filter
+ * pattern are skipped without being exposed.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 filesrc location=/path/to/archive.tar.gz ! gzdec ! tardemux filter="*.csv" ! filesink location=/path/to/first.csv
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/base/gsttypefindhelper.h>
+#include "gsttardemux.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_tar_demux_debug);
+#define GST_CAT_DEFAULT gst_tar_demux_debug
+
+/* POSIX ustar header layout */
+#define TAR_BLOCK 512
+#define TAR_NAME 0
+#define TAR_NAME_SIZE 100
+#define TAR_SIZE 124
+#define TAR_MTIME 136
+#define TAR_CHKSUM 148
+#define TAR_TYPEFLAG 156
+#define TAR_MAGIC 257
+#define TAR_PREFIX 345
+#define TAR_PREFIX_SIZE 155
+/* GNU long names and pax records are metadata, anything this big is bogus */
+#define TAR_MAX_EXTENDED (1024 * 1024)
+
+enum
+{
+  PROP_0,
+  PROP_FILTER
+};
+
+typedef enum
+{
+  TAR_STATE_HEADER,
+  /* collecting a GNU long name or pax extended header */
+  TAR_STATE_EXTENDED,
+  TAR_STATE_DATA,
+  TAR_STATE_PADDING,
+  /* after the two zero blocks that end the archive */
+  TAR_STATE_END
+} GstTarState;
+
+struct _GstTarDemux
+{
+  GstElement parent;
+
+  GstPad *sinkpad;
+
+  gchar *filter;
+  GPatternSpec *pattern;
+
+  GstTarState state;
+  guint8 header[TAR_BLOCK];
+  gsize header_fill;
+  guint zero_blocks;
+  guint64 remaining;
+  guint64 padding;
+  guint64 offset;
+
+  /* what the headers before the next member said about it */
+  gchar ext_type;
+  GByteArray *ext;
+  gchar *long_name;
+  gchar *pax_path;
+  gint64 pax_size;
+  gint64 pax_mtime;
+
+  /* the member being read, pad is created with its first payload */
+  gboolean wanted;
+  gchar *name;
+  guint64 size;
+  guint64 mtime;
+  guint64 member_offset;
+  GstPad *pad;
+
+  guint n_pads;
+  guint group_id;
+  GstFlowCombiner *flowcombiner;
+  GPtrArray *srcpads;
+};
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE("sink",
+                                                                   GST_PAD_SINK,
+                                                                   GST_PAD_ALWAYS,
+                                                                   GST_STATIC_CAPS("application/x-tar"));
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE("src_%u",
+                                                                  GST_PAD_SRC,
+                                                                  GST_PAD_SOMETIMES,
+                                                                  GST_STATIC_CAPS("ANY"));
+
+#define gst_tar_demux_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstTarDemux, gst_tar_demux, GST_TYPE_ELEMENT,
+                        GST_DEBUG_CATEGORY_INIT(gst_tar_demux_debug, "tardemux", 0,
+                                                "Streaming tar demuxer"));
+
+GST_ELEMENT_REGISTER_DEFINE(tardemux, "tardemux", GST_RANK_SECONDARY,
+                            GST_TYPE_TAR_DEMUX);
+
+static void gst_tar_demux_set_property(GObject *object,
+                                       guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_tar_demux_get_property(GObject *object,
+                                       guint prop_id, GValue *value, GParamSpec *pspec);
+static void gst_tar_demux_finalize(GObject *object);
+static GstStateChangeReturn gst_tar_demux_change_state(GstElement *element,
+                                                       GstStateChange transition);
+static GstFlowReturn gst_tar_demux_chain(GstPad *pad,
+                                         GstObject *parent, GstBuffer *buf);
+static gboolean gst_tar_demux_sink_event(GstPad *pad,
+                                         GstObject *parent, GstEvent *event);
+
+static void
+gst_tar_demux_class_init(GstTarDemuxClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *)klass;
+  GstElementClass *gstelement_class = (GstElementClass *)klass;
+
+  gobject_class->set_property = gst_tar_demux_set_property;
+  gobject_class->get_property = gst_tar_demux_get_property;
+  gobject_class->finalize = gst_tar_demux_finalize;
+  gstelement_class->change_state = gst_tar_demux_change_state;
+
+  g_object_class_install_property(gobject_class, PROP_FILTER,
+                                  g_param_spec_string("filter",
+                                                      "Filter",
+                                                      "Glob pattern the path of a member has to match "
+                                                      "for it to be exposed (NULL = all members)",
+                                                      NULL,
+                                                      (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                       GST_PARAM_MUTABLE_READY)));
+
+  gst_element_class_set_details_simple(gstelement_class,
+                                       "tar demuxer",
+                                       "Codec/Demuxer",
+                                       "Splits a tar stream into its members without copying their data",
+                                       "Lenin Torres <<ttvleninn@gmail.com>>");
+
+  gst_element_class_add_pad_template(gstelement_class,
+                                     gst_static_pad_template_get(&src_factory));
+  gst_element_class_add_pad_template(gstelement_class,
+                                     gst_static_pad_template_get(&sink_factory));
+}
+
+static void
+gst_tar_demux_init(GstTarDemux *demux)
+{
+  demux->sinkpad = gst_pad_new_from_static_template(&sink_factory, "sink");
+  gst_pad_set_chain_function(demux->sinkpad,
+                             GST_DEBUG_FUNCPTR(gst_tar_demux_chain));
+  gst_pad_set_event_function(demux->sinkpad,
+                             GST_DEBUG_FUNCPTR(gst_tar_demux_sink_event));
+  gst_element_add_pad(GST_ELEMENT(demux), demux->sinkpad);
+
+  demux->filter = NULL;
+  demux->pattern = NULL;
+  demux->ext = g_byte_array_new();
+  demux->pax_size = -1;
+  demux->pax_mtime = -1;
+  demux->flowcombiner = gst_flow_combiner_new();
+  demux->srcpads = g_ptr_array_new();
+}
+
+static void
+gst_tar_demux_set_property(GObject *object, guint prop_id,
+                           const GValue *value, GParamSpec *pspec)
+{
+  GstTarDemux *demux = GST_TAR_DEMUX(object);
+
+  switch (prop_id)
+  {
+  case PROP_FILTER:
+    g_free(demux->filter);
+    demux->filter = g_value_dup_string(value);
+    g_clear_pointer(&demux->pattern, g_pattern_spec_free);
+    if (demux->filter)
+      demux->pattern = g_pattern_spec_new(demux->filter);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+gst_tar_demux_get_property(GObject *object, guint prop_id,
+                           GValue *value, GParamSpec *pspec)
+{
+  GstTarDemux *demux = GST_TAR_DEMUX(object);
+
+  switch (prop_id)
+  {
+  case PROP_FILTER:
+    g_value_set_string(value, demux->filter);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+/* Forget what the next member's extended headers said */
+static void gst_tar_demux_clear_extended(GstTarDemux *demux)
+{
+  g_byte_array_set_size(demux->ext, 0);
+  g_clear_pointer(&demux->long_name, g_free);
+  g_clear_pointer(&demux->pax_path, g_free);
+  demux->pax_size = -1;
+  demux->pax_mtime = -1;
+}
+
+/* Start parsing again at a header block, keeping the pads already exposed */
+static void gst_tar_demux_reset_parser(GstTarDemux *demux)
+{
+  demux->state = TAR_STATE_HEADER;
+  demux->header_fill = 0;
+  demux->zero_blocks = 0;
+  demux->remaining = 0;
+  demux->padding = 0;
+  demux->offset = 0;
+  gst_tar_demux_clear_extended(demux);
+  demux->wanted = FALSE;
+  g_clear_pointer(&demux->name, g_free);
+  demux->pad = NULL;
+}
+
+static void gst_tar_demux_reset(GstTarDemux *demux)
+{
+  guint i;
+
+  for (i = 0; i < demux->srcpads->len; i++)
+  {
+    GstPad *pad = g_ptr_array_index(demux->srcpads, i);
+
+    gst_flow_combiner_remove_pad(demux->flowcombiner, pad);
+    gst_element_remove_pad(GST_ELEMENT(demux), pad);
+  }
+  g_ptr_array_set_size(demux->srcpads, 0);
+
+  gst_tar_demux_reset_parser(demux);
+  demux->n_pads = 0;
+}
+
+static void
+gst_tar_demux_finalize(GObject *object)
+{
+  GstTarDemux *demux = GST_TAR_DEMUX(object);
+
+  gst_tar_demux_reset(demux);
+  g_byte_array_unref(demux->ext);
+  g_free(demux->filter);
+  g_clear_pointer(&demux->pattern, g_pattern_spec_free);
+  g_ptr_array_free(demux->srcpads, TRUE);
+  gst_flow_combiner_free(demux->flowcombiner);
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static GstStateChangeReturn
+gst_tar_demux_change_state(GstElement *element, GstStateChange transition)
+{
+  GstTarDemux *demux = GST_TAR_DEMUX(element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED)
+  {
+    demux->group_id = gst_util_group_id_next();
+    gst_flow_combiner_reset(demux->flowcombiner);
+  }
+
+  ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    gst_tar_demux_reset(demux);
+  return ret;
+}
+
+/* Octal, or big-endian base-256 when the top bit of the first byte is set
+ * (GNU and star use it for sizes of 8 GB and more). FALSE for negative
+ * base-256 values and ones that do not fit 64 bits. */
+static gboolean tar_parse_number(const guint8 *field, gsize len, guint64 *value)
+{
+  gsize i = 0;
+
+  *value = 0;
+  if (field[0] & 0x80)
+  {
+    /* the next bit is the sign */
+    if (field[0] & 0x40)
+      return FALSE;
+    *value = field[0] & 0x3f;
+    for (i = 1; i < len; i++)
+    {
+      if (*value >> 56)
+        return FALSE;
+      *value = (*value << 8) | field[i];
+    }
+    return TRUE;
+  }
+
+  while (i < len && (field[i] == ' ' || field[i] == '\0'))
+    i++;
+  for (; i < len && field[i] >= '0' && field[i] <= '7'; i++)
+    *value = (*value << 3) | (field[i] - '0');
+  return TRUE;
+}
+
+/* The checksum field counts as spaces. Old tars summed signed chars. */
+static gboolean tar_check_header(const guint8 *header)
+{
+  guint64 stored, sum = 0;
+  gint64 ssum = 0;
+  gsize i;
+
+  if (!tar_parse_number(header + TAR_CHKSUM, 8, &stored))
+    return FALSE;
+  for (i = 0; i < TAR_BLOCK; i++)
+  {
+    guint8 c = (i >= TAR_CHKSUM && i < TAR_CHKSUM + 8) ? ' ' : header[i];
+
+    sum += c;
+    ssum += (gint8)c;
+  }
+  return stored == sum || (gint64)stored == ssum;
+}
+
+static gboolean tar_is_zero_block(const guint8 *header)
+{
+  gsize i;
+
+  for (i = 0; i < TAR_BLOCK; i++)
+    if (header[i])
+      return FALSE;
+  return TRUE;
+}
+
+/* pax records are "<length> <key>=<value>\n" */
+static void gst_tar_demux_parse_pax(GstTarDemux *demux, const guint8 *data, gsize size)
+{
+  gsize pos = 0, len, i;
+  const gchar *key, *value, *eq;
+  gchar *end;
+
+  while (pos < size)
+  {
+    len = g_ascii_strtoull((const gchar *)data + pos, &end, 10);
+    if ((const guint8 *)end == data + pos || *end != ' ' || len == 0 || len > size - pos ||
+        data[pos + len - 1] != '\n')
+      return;
+    key = end + 1;
+    eq = memchr(key, '=', (const gchar *)data + pos + len - 1 - key);
+    if (eq)
+    {
+      value = eq + 1;
+      i = (const gchar *)data + pos + len - 1 - value;
+      if (eq - key == 4 && memcmp(key, "path", 4) == 0)
+      {
+        g_free(demux->pax_path);
+        demux->pax_path = g_strndup(value, i);
+      }
+      else if (eq - key == 4 && memcmp(key, "size", 4) == 0)
+        demux->pax_size = g_ascii_strtoll(value, NULL, 10);
+      else if (eq - key == 5 && memcmp(key, "mtime", 5) == 0)
+        demux->pax_mtime = g_ascii_strtoll(value, NULL, 10);
+    }
+    pos += len;
+  }
+}
+
+/* A GNU long name or pax header was read completely */
+static void gst_tar_demux_end_extended(GstTarDemux *demux)
+{
+  if (demux->ext_type == 'L')
+  {
+    g_free(demux->long_name);
+    demux->long_name = g_strndup((const gchar *)demux->ext->data, demux->ext->len);
+  }
+  else if (demux->ext_type == 'x')
+  {
+    /* terminated so the length digits cannot be read past the end */
+    g_byte_array_append(demux->ext, (const guint8 *)"", 1);
+    gst_tar_demux_parse_pax(demux, demux->ext->data, demux->ext->len - 1);
+  }
+  /* GNU long link names ('K') and global pax headers ('g') are not applied */
+  g_byte_array_set_size(demux->ext, 0);
+}
+
+/* Give the member a pad, with caps typefound from its first bytes */
+static void gst_tar_demux_expose(GstTarDemux *demux, const guint8 *data, gsize size)
+{
+  GstSegment segment;
+  GstTagList *tags;
+  GstDateTime *mtime;
+  GstCaps *caps;
+  GstEvent *event;
+  const gchar *ext;
+  gchar *name, *stream_id;
+
+  name = g_strdup_printf("src_%u", demux->n_pads);
+  demux->pad = gst_pad_new_from_static_template(&src_factory, name);
+  g_free(name);
+  gst_pad_use_fixed_caps(demux->pad);
+  gst_pad_set_active(demux->pad, TRUE);
+
+  stream_id = gst_pad_create_stream_id_printf(demux->pad, GST_ELEMENT(demux), "%u",
+                                              demux->n_pads++);
+  event = gst_event_new_stream_start(stream_id);
+  gst_event_set_group_id(event, demux->group_id);
+  gst_pad_push_event(demux->pad, event);
+  g_free(stream_id);
+
+  ext = strrchr(demux->name, '.');
+  caps = size ? gst_type_find_helper_for_data_with_extension(GST_OBJECT(demux), data, size,
+                                                             ext ? ext + 1 : NULL, NULL)
+              : NULL;
+  if (caps == NULL)
+    caps = gst_caps_new_empty_simple("application/octet-stream");
+  GST_DEBUG_OBJECT(demux, "Member %s has caps %" GST_PTR_FORMAT, demux->name, caps);
+  gst_pad_push_event(demux->pad, gst_event_new_caps(caps));
+  gst_caps_unref(caps);
+
+  gst_element_add_pad(GST_ELEMENT(demux), demux->pad);
+  g_ptr_array_add(demux->srcpads, demux->pad);
+  gst_flow_combiner_add_pad(demux->flowcombiner, demux->pad);
+
+  gst_segment_init(&segment, GST_FORMAT_BYTES);
+  segment.duration = demux->size;
+  gst_pad_push_event(demux->pad, gst_event_new_segment(&segment));
+
+  tags = gst_tag_list_new(GST_TAG_CONTAINER_FORMAT, "tar", GST_TAG_TITLE, demux->name, NULL);
+  /* NULL past year 9999 */
+  if (demux->mtime && (mtime = gst_date_time_new_from_unix_epoch_utc(demux->mtime)) != NULL)
+  {
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_DATE_TIME, mtime, NULL);
+    gst_date_time_unref(mtime);
+  }
+  gst_pad_push_event(demux->pad, gst_event_new_tag(tags));
+}
+
+static void gst_tar_demux_end_member(GstTarDemux *demux)
+{
+  if (demux->wanted && demux->pad == NULL)
+    gst_tar_demux_expose(demux, NULL, 0);
+  if (demux->pad)
+    gst_pad_push_event(demux->pad, gst_event_new_eos());
+  demux->pad = NULL;
+  demux->wanted = FALSE;
+  g_clear_pointer(&demux->name, g_free);
+}
+
+/* Parse a complete header block and decide what follows it */
+static GstFlowReturn gst_tar_demux_header(GstTarDemux *demux)
+{
+  const guint8 *header = demux->header;
+  gchar type = header[TAR_TYPEFLAG];
+  gboolean extended = type == 'L' || type == 'K' || type == 'x' || type == 'g';
+  guint64 size;
+
+  if (tar_is_zero_block(header))
+  {
+    if (++demux->zero_blocks == 2)
+    {
+      GST_DEBUG_OBJECT(demux, "End of archive at %" G_GUINT64_FORMAT, demux->offset);
+      demux->state = TAR_STATE_END;
+    }
+    return GST_FLOW_OK;
+  }
+  demux->zero_blocks = 0;
+  if (!tar_check_header(header) || !tar_parse_number(header + TAR_SIZE, 12, &size))
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL),
+                      ("Invalid tar header at %" G_GUINT64_FORMAT, demux->offset - TAR_BLOCK));
+    return GST_FLOW_ERROR;
+  }
+
+  /* a pax size is meant for the member, never for another extended header */
+  if (!extended && demux->pax_size >= 0)
+    size = demux->pax_size;
+  demux->remaining = size;
+  demux->padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+
+  if (extended)
+  {
+    if (size > TAR_MAX_EXTENDED)
+    {
+      GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL),
+                        ("%" G_GUINT64_FORMAT " byte extended header", size));
+      return GST_FLOW_ERROR;
+    }
+    demux->ext_type = type;
+    demux->state = TAR_STATE_EXTENDED;
+    if (size == 0)
+    {
+      gst_tar_demux_end_extended(demux);
+      demux->state = TAR_STATE_HEADER;
+    }
+    return GST_FLOW_OK;
+  }
+
+  if (demux->pax_path)
+    demux->name = g_strdup(demux->pax_path);
+  else if (demux->long_name)
+    demux->name = g_strdup(demux->long_name);
+  /* POSIX "ustar\0" only, old GNU headers ("ustar  ") keep atime and ctime
+   * where the prefix would be */
+  else if (memcmp(header + TAR_MAGIC, "ustar", 6) == 0 && header[TAR_PREFIX])
+    demux->name = g_strdup_printf("%.*s/%.*s", TAR_PREFIX_SIZE, header + TAR_PREFIX,
+                                  TAR_NAME_SIZE, header + TAR_NAME);
+  else
+    demux->name = g_strndup((const gchar *)header + TAR_NAME, TAR_NAME_SIZE);
+  demux->size = size;
+  if (demux->pax_mtime >= 0)
+    demux->mtime = demux->pax_mtime;
+  else if (!tar_parse_number(header + TAR_MTIME, 12, &demux->mtime))
+    demux->mtime = 0;
+  demux->member_offset = 0;
+  gst_tar_demux_clear_extended(demux);
+
+  /* regular files only, links, directories and devices have no payload */
+  demux->wanted = (type == '0' || type == '\0' || type == '7') &&
+                  (demux->pattern == NULL || g_pattern_spec_match_string(demux->pattern, demux->name));
+  GST_LOG_OBJECT(demux, "Member %s type %c, %" G_GUINT64_FORMAT " bytes%s", demux->name,
+                 type ? type : '0', size, demux->wanted ? "" : ", skipped");
+
+  if (size > 0)
+    demux->state = TAR_STATE_DATA;
+  else
+    gst_tar_demux_end_member(demux);
+  return GST_FLOW_OK;
+}
+
+/* Push part of the member's payload as a sub-buffer of the input */
+static GstFlowReturn gst_tar_demux_push_data(GstTarDemux *demux, GstBuffer *buf,
+                                             const guint8 *data, gsize pos, gsize size)
+{
+  GstBuffer *sub;
+  GstFlowReturn flow;
+
+  if (demux->pad == NULL)
+    gst_tar_demux_expose(demux, data + pos, size);
+
+  sub = gst_buffer_copy_region(buf, GST_BUFFER_COPY_MEMORY, pos, size);
+  GST_BUFFER_OFFSET(sub) = demux->member_offset;
+  demux->member_offset += size;
+  GST_BUFFER_OFFSET_END(sub) = demux->member_offset;
+
+  flow = gst_pad_push(demux->pad, sub);
+  return gst_flow_combiner_update_pad_flow(demux->flowcombiner, demux->pad, flow);
+}
+
+static GstFlowReturn
+gst_tar_demux_chain(GstPad *pad, GstObject *parent, GstBuffer *buf)
+{
+  GstTarDemux *demux = GST_TAR_DEMUX(parent);
+  GstFlowReturn flow = GST_FLOW_OK;
+  GstMapInfo map;
+  gsize pos = 0, n;
+
+  if (!gst_buffer_map(buf, &map, GST_MAP_READ))
+  {
+    gst_buffer_unref(buf);
+    return GST_FLOW_ERROR;
+  }
+
+  while (pos < map.size && flow == GST_FLOW_OK)
+  {
+    n = map.size - pos;
+    switch (demux->state)
+    {
+    case TAR_STATE_HEADER:
+      /* headers are the only bytes ever copied */
+      n = MIN(n, TAR_BLOCK - demux->header_fill);
+      memcpy(demux->header + demux->header_fill, map.data + pos, n);
+      demux->header_fill += n;
+      demux->offset += n;
+      if (demux->header_fill == TAR_BLOCK)
+      {
+        demux->header_fill = 0;
+        flow = gst_tar_demux_header(demux);
+      }
+      break;
+
+    case TAR_STATE_EXTENDED:
+      n = MIN(n, demux->remaining);
+      g_byte_array_append(demux->ext, map.data + pos, n);
+      demux->remaining -= n;
+      demux->offset += n;
+      if (demux->remaining == 0)
+      {
+        gst_tar_demux_end_extended(demux);
+        demux->state = demux->padding ? TAR_STATE_PADDING : TAR_STATE_HEADER;
+      }
+      break;
+
+    case TAR_STATE_DATA:
+      n = MIN(n, demux->remaining);
+      if (demux->wanted)
+        flow = gst_tar_demux_push_data(demux, buf, map.data, pos, n);
+      demux->remaining -= n;
+      demux->offset += n;
+      if (demux->remaining == 0)
+      {
+        gst_tar_demux_end_member(demux);
+        demux->state = demux->padding ? TAR_STATE_PADDING : TAR_STATE_HEADER;
+      }
+      break;
+
+    case TAR_STATE_PADDING:
+      n = MIN(n, demux->padding);
+      demux->padding -= n;
+      demux->offset += n;
+      if (demux->padding == 0)
+        demux->state = TAR_STATE_HEADER;
+      break;
+
+    case TAR_STATE_END:
+      /* tar pads archives to whole records, ignore whatever follows */
+      n = map.size - pos;
+      break;
+    }
+    pos += n;
+  }
+
+  gst_buffer_unmap(buf, &map);
+  gst_buffer_unref(buf);
+  return flow;
+}
+
+static gboolean
+gst_tar_demux_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
+{
+  GstTarDemux *demux = GST_TAR_DEMUX(parent);
+
+  switch (GST_EVENT_TYPE(event))
+  {
+  case GST_EVENT_STREAM_START:
+  case GST_EVENT_CAPS:
+  case GST_EVENT_SEGMENT:
+  case GST_EVENT_TAG:
+    /* every member pad sends its own */
+    gst_event_unref(event);
+    return TRUE;
+  case GST_EVENT_FLUSH_STOP:
+    /* data resumes at a header, drop the member and headers cut short */
+    gst_tar_demux_reset_parser(demux);
+    gst_flow_combiner_reset(demux->flowcombiner);
+    break;
+  case GST_EVENT_EOS:
+    if (demux->state == TAR_STATE_DATA || demux->state == TAR_STATE_EXTENDED ||
+        demux->header_fill > 0)
+      GST_ELEMENT_WARNING(demux, STREAM, DEMUX, (NULL),
+                          ("Archive is truncated at %" G_GUINT64_FORMAT, demux->offset));
+    if (demux->state == TAR_STATE_DATA)
+      gst_tar_demux_end_member(demux);
+    if (demux->srcpads->len == 0)
+    {
+      GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL), ("No matching members in the archive"));
+      gst_event_unref(event);
+      return TRUE;
+    }
+    gst_element_no_more_pads(GST_ELEMENT(demux));
+    /* every pad already got its EOS */
+    gst_event_unref(event);
+    return TRUE;
+  default:
+    break;
+  }
+
+  return gst_pad_event_default(pad, parent, event);
+}
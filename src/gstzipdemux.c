@@ -0,0 +1,1032 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-zipdemux
+ *
+ * Splits a .zip archive into its entries. The central directory is read
+ * from the end of the file in pull mode, then every file entry is decoded
+ * and pushed on its own sometimes pad, in directory order, with its name
+ * and modification time as tags. Deflate and bzip2 entries are decoded
+ * concurrently on the worker pool shared with gzdec, stored entries are
+ * pushed as the buffer pulled from upstream.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 filesrc location=/path/to/archive.zip ! zipdemux ! filesink location=/path/to/first/entry
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/base/gsttypefindhelper.h>
+#include "gstgzdec.h"
+#include "gstgzdecpool.h"
+#include "gstzipdemux.h"
+#include "gzdeccore.h"
+#include "gzdeccrc.h"
+
+#include <string.h>
+#include <zlib.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_zip_demux_debug);
+#define GST_CAT_DEFAULT gst_zip_demux_debug
+#define DEFAULT_THREADS 0
+#define DEFAULT_MAX_IN_FLIGHT 4
+#define DEFAULT_VERIFY VERIFY_CRC32
+
+/* ZIP record signatures and fixed sizes (APPNOTE.TXT) */
+#define ZIP_LOCAL_SIG 0x04034b50
+#define ZIP_CENTRAL_SIG 0x02014b50
+#define ZIP_EOCD_SIG 0x06054b50
+#define ZIP64_LOCATOR_SIG 0x07064b50
+#define ZIP64_EOCD_SIG 0x06064b50
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP64_EOCD_SIZE 56
+#define ZIP_MAX_COMMENT 65535
+#define ZIP64_EXTRA_ID 0x0001
+
+#define ZIP_FLAG_ENCRYPTED 0x0001
+#define ZIP_FLAG_UTF8 0x0800
+
+#define ZIP_METHOD_STORED 0
+#define ZIP_METHOD_DEFLATE 8
+#define ZIP_METHOD_BZIP2 12
+
+enum
+{
+  PROP_0,
+  PROP_THREADS,
+  PROP_MAX_IN_FLIGHT,
+  PROP_VERIFY
+};
+
+/* A file entry of the central directory */
+typedef struct
+{
+  gchar *name;
+  guint16 method;
+  guint16 dos_time;
+  guint16 dos_date;
+  guint32 crc;
+  guint64 csize;
+  guint64 usize;
+  /* of the local header */
+  guint64 offset;
+} ZipEntry;
+
+/* One entry travelling through the worker pool */
+typedef struct
+{
+  guint index;
+  const ZipEntry *entry;
+  GstDecVerify verify;
+  GstBuffer *in;
+  GstBuffer *out;
+  const gchar *error;
+  gboolean done;
+} ZipJob;
+
+struct _GstZipDemux
+{
+  GstElement parent;
+
+  GstPad *sinkpad;
+
+  guint threads;
+  guint max_in_flight;
+  GstDecVerify verify;
+
+  /* the central directory, read once by the streaming task */
+  GArray *entries;
+  gboolean have_directory;
+  guint next_job;
+  guint group_id;
+  GstFlowCombiner *flowcombiner;
+  GPtrArray *srcpads;
+
+  /* entries are decoded on the shared pool and pushed in directory order */
+  GzdecPoolClient *client;
+  GQueue jobs;
+  GMutex jobs_lock;
+  GCond jobs_cond;
+};
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE("sink",
+                                                                   GST_PAD_SINK,
+                                                                   GST_PAD_ALWAYS,
+                                                                   GST_STATIC_CAPS("application/zip"));
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE("src_%u",
+                                                                  GST_PAD_SRC,
+                                                                  GST_PAD_SOMETIMES,
+                                                                  GST_STATIC_CAPS("ANY"));
+
+#define gst_zip_demux_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstZipDemux, gst_zip_demux, GST_TYPE_ELEMENT,
+                        GST_DEBUG_CATEGORY_INIT(gst_zip_demux_debug, "zipdemux", 0,
+                                                "ZIP archive demuxer"));
+
+GST_ELEMENT_REGISTER_DEFINE(zipdemux, "zipdemux", GST_RANK_SECONDARY,
+                            GST_TYPE_ZIP_DEMUX);
+
+static void gst_zip_demux_set_property(GObject *object,
+                                       guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_zip_demux_get_property(GObject *object,
+                                       guint prop_id, GValue *value, GParamSpec *pspec);
+static void gst_zip_demux_finalize(GObject *object);
+static GstStateChangeReturn gst_zip_demux_change_state(GstElement *element,
+                                                       GstStateChange transition);
+static gboolean gst_zip_demux_sink_activate(GstPad *pad, GstObject *parent);
+static gboolean gst_zip_demux_sink_activate_mode(GstPad *pad, GstObject *parent,
+                                                 GstPadMode mode, gboolean active);
+static void gst_zip_demux_loop(GstPad *pad);
+
+static void
+gst_zip_demux_class_init(GstZipDemuxClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *)klass;
+  GstElementClass *gstelement_class = (GstElementClass *)klass;
+
+  gobject_class->set_property = gst_zip_demux_set_property;
+  gobject_class->get_property = gst_zip_demux_get_property;
+  gobject_class->finalize = gst_zip_demux_finalize;
+  gstelement_class->change_state = gst_zip_demux_change_state;
+
+  g_object_class_install_property(gobject_class, PROP_THREADS,
+                                  g_param_spec_uint("threads",
+                                                    "Threads",
+                                                    "Shared pool threads decoding entries at once "
+                                                    "(0 = any, 1 = decode in the streaming thread)",
+                                                    0, 256, DEFAULT_THREADS,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_MAX_IN_FLIGHT,
+                                  g_param_spec_uint("max-in-flight",
+                                                    "Max in flight",
+                                                    "Maximum number of entries read and being decoded "
+                                                    "ahead of the one being pushed",
+                                                    1, 4096, DEFAULT_MAX_IN_FLIGHT,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(gobject_class, PROP_VERIFY,
+                                  g_param_spec_enum("verify",
+                                                    "Verify",
+                                                    "How entry checksums are verified",
+                                                    GST_TYPE_VERIFY, DEFAULT_VERIFY,
+                                                    (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                                                     GST_PARAM_MUTABLE_READY)));
+
+  gst_element_class_set_details_simple(gstelement_class,
+                                       "ZIP demuxer",
+                                       "Codec/Demuxer",
+                                       "Decodes the entries of a .zip archive in parallel, one pad per entry",
+                                       "Lenin Torres <<ttvleninn@gmail.com>>");
+
+  gst_element_class_add_pad_template(gstelement_class,
+                                     gst_static_pad_template_get(&src_factory));
+  gst_element_class_add_pad_template(gstelement_class,
+                                     gst_static_pad_template_get(&sink_factory));
+}
+
+static void
+gst_zip_demux_init(GstZipDemux *demux)
+{
+  demux->sinkpad = gst_pad_new_from_static_template(&sink_factory, "sink");
+  gst_pad_set_activate_function(demux->sinkpad,
+                                GST_DEBUG_FUNCPTR(gst_zip_demux_sink_activate));
+  gst_pad_set_activatemode_function(demux->sinkpad,
+                                    GST_DEBUG_FUNCPTR(gst_zip_demux_sink_activate_mode));
+  gst_element_add_pad(GST_ELEMENT(demux), demux->sinkpad);
+
+  demux->threads = DEFAULT_THREADS;
+  demux->max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+  demux->verify = DEFAULT_VERIFY;
+  demux->entries = g_array_new(FALSE, FALSE, sizeof(ZipEntry));
+  demux->flowcombiner = gst_flow_combiner_new();
+  demux->srcpads = g_ptr_array_new();
+  demux->client = NULL;
+  g_queue_init(&demux->jobs);
+  g_mutex_init(&demux->jobs_lock);
+  g_cond_init(&demux->jobs_cond);
+}
+
+static void
+gst_zip_demux_set_property(GObject *object, guint prop_id,
+                           const GValue *value, GParamSpec *pspec)
+{
+  GstZipDemux *demux = GST_ZIP_DEMUX(object);
+
+  switch (prop_id)
+  {
+  case PROP_THREADS:
+    demux->threads = g_value_get_uint(value);
+    break;
+  case PROP_MAX_IN_FLIGHT:
+    demux->max_in_flight = g_value_get_uint(value);
+    break;
+  case PROP_VERIFY:
+    demux->verify = g_value_get_enum(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+gst_zip_demux_get_property(GObject *object, guint prop_id,
+                           GValue *value, GParamSpec *pspec)
+{
+  GstZipDemux *demux = GST_ZIP_DEMUX(object);
+
+  switch (prop_id)
+  {
+  case PROP_THREADS:
+    g_value_set_uint(value, demux->threads);
+    break;
+  case PROP_MAX_IN_FLIGHT:
+    g_value_set_uint(value, demux->max_in_flight);
+    break;
+  case PROP_VERIFY:
+    g_value_set_enum(value, demux->verify);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void zip_job_free(gpointer data)
+{
+  ZipJob *job = data;
+
+  if (job->in)
+    gst_buffer_unref(job->in);
+  if (job->out)
+    gst_buffer_unref(job->out);
+  g_free(job);
+}
+
+/* Wait for the workers and drop everything still queued */
+static void gst_zip_demux_discard_jobs(GstZipDemux *demux)
+{
+  ZipJob *job;
+
+  g_mutex_lock(&demux->jobs_lock);
+  while ((job = g_queue_peek_head(&demux->jobs)) != NULL)
+  {
+    if (!job->done)
+    {
+      g_cond_wait(&demux->jobs_cond, &demux->jobs_lock);
+      continue;
+    }
+    g_queue_pop_head(&demux->jobs);
+    zip_job_free(job);
+  }
+  g_mutex_unlock(&demux->jobs_lock);
+}
+
+static void gst_zip_demux_reset(GstZipDemux *demux)
+{
+  guint i;
+
+  gst_zip_demux_discard_jobs(demux);
+  for (i = 0; i < demux->srcpads->len; i++)
+  {
+    GstPad *pad = g_ptr_array_index(demux->srcpads, i);
+
+    gst_flow_combiner_remove_pad(demux->flowcombiner, pad);
+    gst_element_remove_pad(GST_ELEMENT(demux), pad);
+  }
+  g_ptr_array_set_size(demux->srcpads, 0);
+
+  for (i = 0; i < demux->entries->len; i++)
+    g_free(g_array_index(demux->entries, ZipEntry, i).name);
+  g_array_set_size(demux->entries, 0);
+  demux->have_directory = FALSE;
+  demux->next_job = 0;
+}
+
+static void
+gst_zip_demux_finalize(GObject *object)
+{
+  GstZipDemux *demux = GST_ZIP_DEMUX(object);
+
+  gst_zip_demux_reset(demux);
+  g_array_free(demux->entries, TRUE);
+  g_ptr_array_free(demux->srcpads, TRUE);
+  gst_flow_combiner_free(demux->flowcombiner);
+  g_mutex_clear(&demux->jobs_lock);
+  g_cond_clear(&demux->jobs_cond);
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static GstStateChangeReturn
+gst_zip_demux_change_state(GstElement *element, GstStateChange transition)
+{
+  GstZipDemux *demux = GST_ZIP_DEMUX(element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED)
+  {
+    demux->group_id = gst_util_group_id_next();
+    gst_flow_combiner_reset(demux->flowcombiner);
+    if (demux->threads != 1)
+    {
+      GstGzdecPool *pool = gst_gzdec_pool_get_default();
+
+      demux->client = gst_gzdec_pool_client_new(pool, demux->threads, 1);
+      gst_object_unref(pool);
+    }
+  }
+
+  ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+  {
+    /* the streaming task is stopped, only workers may still run */
+    gst_zip_demux_reset(demux);
+    if (demux->client)
+    {
+      gst_gzdec_pool_client_free(demux->client);
+      demux->client = NULL;
+    }
+  }
+  return ret;
+}
+
+/* The central directory is at the end of the archive, so upstream has to
+ * be seekable */
+static gboolean
+gst_zip_demux_sink_activate(GstPad *pad, GstObject *parent)
+{
+  GstQuery *query;
+  gboolean pull;
+
+  query = gst_query_new_scheduling();
+  pull = gst_pad_peer_query(pad, query) &&
+         gst_query_has_scheduling_mode_with_flags(query, GST_PAD_MODE_PULL,
+                                                  GST_SCHEDULING_FLAG_SEEKABLE);
+  gst_query_unref(query);
+
+  if (!pull)
+  {
+    GST_ELEMENT_ERROR(parent, STREAM, DEMUX, (NULL),
+                      ("zipdemux needs an upstream element that supports pull mode"));
+    return FALSE;
+  }
+  return gst_pad_activate_mode(pad, GST_PAD_MODE_PULL, TRUE);
+}
+
+static gboolean
+gst_zip_demux_sink_activate_mode(GstPad *pad, GstObject *parent,
+                                 GstPadMode mode, gboolean active)
+{
+  if (mode != GST_PAD_MODE_PULL)
+    return FALSE;
+  if (active)
+    return gst_pad_start_task(pad, (GstTaskFunction)gst_zip_demux_loop, pad, NULL);
+  return gst_pad_stop_task(pad);
+}
+
+/* Pull exactly size bytes at offset */
+static GstFlowReturn gst_zip_demux_pull(GstZipDemux *demux, guint64 offset, guint64 size,
+                                        GstBuffer **buf)
+{
+  GstFlowReturn flow;
+
+  *buf = NULL;
+  if (size == 0)
+  {
+    *buf = gst_buffer_new();
+    return GST_FLOW_OK;
+  }
+  if (size > G_MAXUINT)
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL),
+                      ("%" G_GUINT64_FORMAT " byte record is too large", size));
+    return GST_FLOW_ERROR;
+  }
+
+  flow = gst_pad_pull_range(demux->sinkpad, offset, size, buf);
+  if (flow != GST_FLOW_OK)
+    return flow;
+  if (gst_buffer_get_size(*buf) != size)
+  {
+    gst_buffer_unref(*buf);
+    *buf = NULL;
+    GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL),
+                      ("Archive is truncated at %" G_GUINT64_FORMAT, offset));
+    return GST_FLOW_ERROR;
+  }
+  return GST_FLOW_OK;
+}
+
+/* Entry names are UTF-8 when flagged, CP437 by the original spec */
+static gchar *zip_entry_name(const guint8 *data, gsize len, guint16 flags)
+{
+  gchar *name = NULL;
+
+  if (!(flags & ZIP_FLAG_UTF8) && !g_utf8_validate((const gchar *)data, len, NULL))
+    name = g_convert((const gchar *)data, len, "UTF-8", "CP437", NULL, NULL, NULL);
+  if (name == NULL)
+    name = g_utf8_make_valid((const gchar *)data, len);
+  return name;
+}
+
+/* Sizes and offset that did not fit in 32 bits are in the ZIP64 extra
+ * field, in this order and only those that are saturated */
+static void zip_entry_read_zip64(ZipEntry *entry, const guint8 *extra, gsize len)
+{
+  guint16 id, size;
+  gsize pos;
+
+  while (len >= 4)
+  {
+    id = GST_READ_UINT16_LE(extra);
+    size = GST_READ_UINT16_LE(extra + 2);
+    if (size > len - 4)
+      return;
+    if (id == ZIP64_EXTRA_ID)
+    {
+      pos = 4;
+      if (entry->usize == G_MAXUINT32 && pos + 8 <= 4u + size)
+      {
+        entry->usize = GST_READ_UINT64_LE(extra + pos);
+        pos += 8;
+      }
+      if (entry->csize == G_MAXUINT32 && pos + 8 <= 4u + size)
+      {
+        entry->csize = GST_READ_UINT64_LE(extra + pos);
+        pos += 8;
+      }
+      if (entry->offset == G_MAXUINT32 && pos + 8 <= 4u + size)
+        entry->offset = GST_READ_UINT64_LE(extra + pos);
+      return;
+    }
+    extra += 4 + size;
+    len -= 4 + size;
+  }
+}
+
+static gboolean gst_zip_demux_parse_directory(GstZipDemux *demux, const guint8 *data,
+                                              gsize size, guint64 count)
+{
+  ZipEntry entry;
+  guint16 flags, name_len, extra_len, comment_len;
+  gsize pos = 0;
+  guint64 i;
+
+  for (i = 0; i < count; i++)
+  {
+    if (size - pos < ZIP_CENTRAL_SIZE || GST_READ_UINT32_LE(data + pos) != ZIP_CENTRAL_SIG)
+      return FALSE;
+    flags = GST_READ_UINT16_LE(data + pos + 8);
+    name_len = GST_READ_UINT16_LE(data + pos + 28);
+    extra_len = GST_READ_UINT16_LE(data + pos + 30);
+    comment_len = GST_READ_UINT16_LE(data + pos + 32);
+    if (size - pos - ZIP_CENTRAL_SIZE < (gsize)name_len + extra_len + comment_len)
+      return FALSE;
+
+    entry.method = GST_READ_UINT16_LE(data + pos + 10);
+    entry.dos_time = GST_READ_UINT16_LE(data + pos + 12);
+    entry.dos_date = GST_READ_UINT16_LE(data + pos + 14);
+    entry.crc = GST_READ_UINT32_LE(data + pos + 16);
+    entry.csize = GST_READ_UINT32_LE(data + pos + 20);
+    entry.usize = GST_READ_UINT32_LE(data + pos + 24);
+    entry.offset = GST_READ_UINT32_LE(data + pos + 42);
+    entry.name = zip_entry_name(data + pos + ZIP_CENTRAL_SIZE, name_len, flags);
+    zip_entry_read_zip64(&entry, data + pos + ZIP_CENTRAL_SIZE + name_len, extra_len);
+    pos += ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len;
+
+    /* directories carry no data */
+    if (g_str_has_suffix(entry.name, "/"))
+    {
+      g_free(entry.name);
+      continue;
+    }
+    if (flags & ZIP_FLAG_ENCRYPTED)
+    {
+      GST_ELEMENT_WARNING(demux, STREAM, DECRYPT, (NULL),
+                          ("Skipping encrypted entry %s", entry.name));
+      g_free(entry.name);
+      continue;
+    }
+    if (entry.method != ZIP_METHOD_STORED && entry.method != ZIP_METHOD_DEFLATE &&
+        entry.method != ZIP_METHOD_BZIP2)
+    {
+      GST_ELEMENT_WARNING(demux, STREAM, CODEC_NOT_FOUND, (NULL),
+                          ("Skipping entry %s with unsupported method %u", entry.name,
+                           entry.method));
+      g_free(entry.name);
+      continue;
+    }
+    if (entry.method == ZIP_METHOD_STORED && entry.csize != entry.usize)
+      return FALSE;
+
+    GST_LOG_OBJECT(demux, "Entry %s, method %u, %" G_GUINT64_FORMAT " -> %" G_GUINT64_FORMAT
+                   " bytes at %" G_GUINT64_FORMAT,
+                   entry.name, entry.method, entry.csize, entry.usize, entry.offset);
+    g_array_append_val(demux->entries, entry);
+  }
+  return TRUE;
+}
+
+/* Find the end of central directory record, following it to the ZIP64 one
+ * when the archive needs it, and read every entry */
+static GstFlowReturn gst_zip_demux_read_directory(GstZipDemux *demux)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  GstFlowReturn flow;
+  gint64 file_size;
+  guint64 tail, eocd = 0, count = 0, dir_size = 0, dir_offset = 0;
+  gsize pos;
+  guint i;
+  gboolean found = FALSE, ok;
+
+  if (!gst_pad_peer_query_duration(demux->sinkpad, GST_FORMAT_BYTES, &file_size) ||
+      file_size < ZIP_EOCD_SIZE)
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, WRONG_TYPE, (NULL), ("Not a ZIP archive"));
+    return GST_FLOW_ERROR;
+  }
+
+  /* the record is followed by a comment of up to 64 kB */
+  tail = MIN((guint64)file_size, ZIP_EOCD_SIZE + ZIP_MAX_COMMENT);
+  if ((flow = gst_zip_demux_pull(demux, file_size - tail, tail, &buf)) != GST_FLOW_OK)
+    return flow;
+  gst_buffer_map(buf, &map, GST_MAP_READ);
+  for (pos = map.size - ZIP_EOCD_SIZE + 1; pos-- > 0;)
+  {
+    if (GST_READ_UINT32_LE(map.data + pos) == ZIP_EOCD_SIG &&
+        pos + ZIP_EOCD_SIZE + GST_READ_UINT16_LE(map.data + pos + 20) <= map.size)
+    {
+      eocd = file_size - tail + pos;
+      count = GST_READ_UINT16_LE(map.data + pos + 10);
+      dir_size = GST_READ_UINT32_LE(map.data + pos + 12);
+      dir_offset = GST_READ_UINT32_LE(map.data + pos + 16);
+      found = TRUE;
+      break;
+    }
+  }
+  gst_buffer_unmap(buf, &map);
+  gst_buffer_unref(buf);
+  if (!found)
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, WRONG_TYPE, (NULL), ("Not a ZIP archive"));
+    return GST_FLOW_ERROR;
+  }
+
+  if ((count == G_MAXUINT16 || dir_size == G_MAXUINT32 || dir_offset == G_MAXUINT32) &&
+      eocd >= ZIP64_LOCATOR_SIZE)
+  {
+    guint64 zip64_eocd = 0;
+
+    if ((flow = gst_zip_demux_pull(demux, eocd - ZIP64_LOCATOR_SIZE, ZIP64_LOCATOR_SIZE,
+                                   &buf)) != GST_FLOW_OK)
+      return flow;
+    gst_buffer_map(buf, &map, GST_MAP_READ);
+    if (GST_READ_UINT32_LE(map.data) == ZIP64_LOCATOR_SIG)
+      zip64_eocd = GST_READ_UINT64_LE(map.data + 8);
+    gst_buffer_unmap(buf, &map);
+    gst_buffer_unref(buf);
+
+    if (zip64_eocd > 0 && zip64_eocd + ZIP64_EOCD_SIZE <= eocd)
+    {
+      if ((flow = gst_zip_demux_pull(demux, zip64_eocd, ZIP64_EOCD_SIZE, &buf)) != GST_FLOW_OK)
+        return flow;
+      gst_buffer_map(buf, &map, GST_MAP_READ);
+      if (GST_READ_UINT32_LE(map.data) == ZIP64_EOCD_SIG)
+      {
+        count = GST_READ_UINT64_LE(map.data + 32);
+        dir_size = GST_READ_UINT64_LE(map.data + 40);
+        dir_offset = GST_READ_UINT64_LE(map.data + 48);
+        eocd = zip64_eocd;
+      }
+      gst_buffer_unmap(buf, &map);
+      gst_buffer_unref(buf);
+    }
+  }
+
+  if (dir_offset > eocd || dir_size > eocd - dir_offset)
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL), ("Corrupt central directory"));
+    return GST_FLOW_ERROR;
+  }
+  GST_DEBUG_OBJECT(demux, "%" G_GUINT64_FORMAT " entries in %" G_GUINT64_FORMAT
+                   " bytes at %" G_GUINT64_FORMAT, count, dir_size, dir_offset);
+
+  if ((flow = gst_zip_demux_pull(demux, dir_offset, dir_size, &buf)) != GST_FLOW_OK)
+    return flow;
+  gst_buffer_map(buf, &map, GST_MAP_READ);
+  ok = gst_zip_demux_parse_directory(demux, map.data, map.size, count);
+  gst_buffer_unmap(buf, &map);
+  gst_buffer_unref(buf);
+  if (!ok)
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL), ("Corrupt central directory"));
+    return GST_FLOW_ERROR;
+  }
+
+  /* the output buffer is allocated from usize, don't trust a size the
+   * compressed data could never expand to */
+  for (i = 0; i < demux->entries->len; i++)
+  {
+    ZipEntry *entry = &g_array_index(demux->entries, ZipEntry, i);
+    guint64 ratio = entry->method == ZIP_METHOD_BZIP2 ? GZDEC_CORE_MAX_BZIP2_RATIO
+                                                      : GZDEC_CORE_MAX_DEFLATE_RATIO;
+
+    if (entry->method != ZIP_METHOD_STORED && entry->usize / ratio > entry->csize)
+    {
+      GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL),
+                        ("Entry %s claims %" G_GUINT64_FORMAT " bytes from %" G_GUINT64_FORMAT
+                         " compressed bytes",
+                         entry->name, entry->usize, entry->csize));
+      return GST_FLOW_ERROR;
+    }
+  }
+  return GST_FLOW_OK;
+}
+
+/* Decoder owned by a worker thread, reused for every entry it decodes */
+typedef struct
+{
+  GzdecCore *deflate;
+  GzdecCore *bzip2;
+} ZipWorkerCtx;
+
+static void zip_worker_ctx_free(gpointer data)
+{
+  ZipWorkerCtx *ctx = data;
+
+  gzdec_core_free(ctx->deflate);
+  gzdec_core_free(ctx->bzip2);
+  g_free(ctx);
+}
+
+static GPrivate zip_worker_ctx = G_PRIVATE_INIT(zip_worker_ctx_free);
+
+static GzdecCore *zip_worker_core(guint16 method)
+{
+  ZipWorkerCtx *ctx = g_private_get(&zip_worker_ctx);
+
+  if (ctx == NULL)
+  {
+    ctx = g_new0(ZipWorkerCtx, 1);
+    g_private_set(&zip_worker_ctx, ctx);
+  }
+  if (method == ZIP_METHOD_BZIP2)
+  {
+    if (ctx->bzip2 == NULL)
+      ctx->bzip2 = gzdec_core_new(GZDEC_CORE_BZIP2_BUILTIN, GZDEC_CORE_VERIFY_CRC32);
+    return ctx->bzip2;
+  }
+  if (ctx->deflate == NULL)
+    ctx->deflate = gzdec_core_new(GZDEC_CORE_DEFLATE, GZDEC_CORE_VERIFY_CRC32);
+  return ctx->deflate;
+}
+
+static GzdecCoreVerify zip_core_verify(GstDecVerify verify)
+{
+  switch (verify)
+  {
+  case VERIFY_NONE:
+    return GZDEC_CORE_VERIFY_NONE;
+  case VERIFY_CRC32_FAST:
+    return GZDEC_CORE_VERIFY_CRC32_FAST;
+  default:
+    return GZDEC_CORE_VERIFY_CRC32;
+  }
+}
+
+/* CRC-32 of data the core did not checksum itself */
+static guint32 zip_crc32(GstDecVerify verify, const guint8 *data, gsize size)
+{
+  return verify == VERIFY_CRC32_FAST ? gzdec_crc32_fast(0, data, size) : crc32(0, data, size);
+}
+
+/* Decode a whole entry into one buffer of the size the directory gives.
+ * Stored entries are the pulled buffer itself. */
+static void zip_decode_entry(ZipJob *job)
+{
+  const ZipEntry *entry = job->entry;
+  GzdecCore *core;
+  GzdecCoreStatus status;
+  GstMapInfo inmap, outmap;
+  guint8 extra;
+  gsize used = 0, written;
+
+  if (entry->method == ZIP_METHOD_STORED)
+  {
+    job->out = job->in;
+    job->in = NULL;
+    if (job->verify == VERIFY_NONE)
+      return;
+    gst_buffer_map(job->out, &outmap, GST_MAP_READ);
+    if (zip_crc32(job->verify, outmap.data, outmap.size) != entry->crc)
+      job->error = "CRC-32 mismatch";
+    gst_buffer_unmap(job->out, &outmap);
+    return;
+  }
+
+  core = zip_worker_core(entry->method);
+  if (core == NULL || gzdec_core_reset(core) != 0)
+  {
+    job->error = "out of memory";
+    return;
+  }
+  gzdec_core_set_verify(core, zip_core_verify(job->verify));
+
+  job->out = gst_buffer_new_allocate(NULL, entry->usize, NULL);
+  if (job->out == NULL)
+  {
+    job->error = "out of memory";
+    return;
+  }
+  gst_buffer_map(job->in, &inmap, GST_MAP_READ);
+  gst_buffer_map(job->out, &outmap, GST_MAP_WRITE);
+  gzdec_core_feed(core, inmap.data, inmap.size);
+  do
+  {
+    /* once the announced size is reached, only the end of the stream may follow */
+    if (used < outmap.size)
+      status = gzdec_core_read(core, outmap.data + used, outmap.size - used, &written);
+    else
+      status = gzdec_core_read(core, &extra, 1, &written);
+    used += written;
+    if (status == GZDEC_CORE_ERROR)
+      job->error = gzdec_core_error(core);
+    else if (used > outmap.size)
+      job->error = "entry is larger than its directory record";
+    else if (status == GZDEC_CORE_OK && written == 0 && gzdec_core_input_left(core) == 0)
+      job->error = "entry is truncated";
+  } while (status != GZDEC_CORE_MEMBER_END && job->error == NULL);
+
+  if (job->error == NULL && used != outmap.size)
+    job->error = "entry is smaller than its directory record";
+  /* bzip2 only checks its own block CRCs, the directory's is over the output */
+  else if (job->error == NULL && job->verify != VERIFY_NONE &&
+           (entry->method == ZIP_METHOD_DEFLATE ? gzdec_core_get_crc(core)
+                                                : zip_crc32(job->verify, outmap.data, used)) !=
+               entry->crc)
+    job->error = "CRC-32 mismatch";
+
+  gzdec_core_feed(core, NULL, 0);
+  gst_buffer_unmap(job->out, &outmap);
+  gst_buffer_unmap(job->in, &inmap);
+}
+
+/* worker pool function */
+static void zip_worker_func(gpointer data, gpointer user_data)
+{
+  ZipJob *job = data;
+  GstZipDemux *demux = user_data;
+
+  zip_decode_entry(job);
+
+  g_mutex_lock(&demux->jobs_lock);
+  job->done = TRUE;
+  g_cond_broadcast(&demux->jobs_cond);
+  g_mutex_unlock(&demux->jobs_lock);
+}
+
+/* Read the next entry's data and queue it for decoding */
+static GstFlowReturn gst_zip_demux_submit(GstZipDemux *demux)
+{
+  const ZipEntry *entry = &g_array_index(demux->entries, ZipEntry, demux->next_job);
+  GstBuffer *buf;
+  GstMapInfo map;
+  GstFlowReturn flow;
+  ZipJob *job;
+  guint64 data_offset = 0;
+
+  if ((flow = gst_zip_demux_pull(demux, entry->offset, ZIP_LOCAL_SIZE, &buf)) != GST_FLOW_OK)
+    return flow;
+  gst_buffer_map(buf, &map, GST_MAP_READ);
+  /* the local name and extra field may differ from the central ones */
+  if (GST_READ_UINT32_LE(map.data) == ZIP_LOCAL_SIG)
+    data_offset = entry->offset + ZIP_LOCAL_SIZE + GST_READ_UINT16_LE(map.data + 26) +
+                  GST_READ_UINT16_LE(map.data + 28);
+  gst_buffer_unmap(buf, &map);
+  gst_buffer_unref(buf);
+  if (data_offset == 0)
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL),
+                      ("No local header for entry %s", entry->name));
+    return GST_FLOW_ERROR;
+  }
+
+  if ((flow = gst_zip_demux_pull(demux, data_offset, entry->csize, &buf)) != GST_FLOW_OK)
+    return flow;
+
+  job = g_new0(ZipJob, 1);
+  job->index = demux->next_job++;
+  job->entry = entry;
+  job->verify = demux->verify;
+  job->in = buf;
+
+  g_mutex_lock(&demux->jobs_lock);
+  g_queue_push_tail(&demux->jobs, job);
+  g_mutex_unlock(&demux->jobs_lock);
+  if (demux->client)
+    gst_gzdec_pool_client_push(demux->client, zip_worker_func, job, demux);
+  else
+    zip_worker_func(job, demux);
+  return GST_FLOW_OK;
+}
+
+/* Modification time of an entry, MS-DOS dates are local time */
+static GstDateTime *zip_entry_date_time(const ZipEntry *entry)
+{
+  gint year = 1980 + (entry->dos_date >> 9);
+  gint month = (entry->dos_date >> 5) & 0x0f;
+  gint day = entry->dos_date & 0x1f;
+  gint hour = entry->dos_time >> 11;
+  gint minute = (entry->dos_time >> 5) & 0x3f;
+  gint second = (entry->dos_time & 0x1f) * 2;
+
+  if (month < 1 || month > 12 || day < 1 || hour > 23 || minute > 59 || second > 59)
+    return NULL;
+  return gst_date_time_new_local_time(year, month, day, hour, minute, second);
+}
+
+/* Expose a decoded entry on a new pad and send it, followed by EOS */
+static GstFlowReturn gst_zip_demux_push_entry(GstZipDemux *demux, ZipJob *job)
+{
+  const ZipEntry *entry = job->entry;
+  GstBuffer *out = job->out;
+  GstSegment segment;
+  GstTagList *tags;
+  GstDateTime *mtime;
+  GstCaps *caps;
+  GstEvent *event;
+  GstPad *pad;
+  GstFlowReturn flow;
+  const gchar *ext;
+  gchar *name, *stream_id;
+
+  name = g_strdup_printf("src_%u", job->index);
+  pad = gst_pad_new_from_static_template(&src_factory, name);
+  g_free(name);
+  gst_pad_use_fixed_caps(pad);
+  gst_pad_set_active(pad, TRUE);
+
+  stream_id = gst_pad_create_stream_id_printf(pad, GST_ELEMENT(demux), "%u", job->index);
+  event = gst_event_new_stream_start(stream_id);
+  gst_event_set_group_id(event, demux->group_id);
+  gst_pad_push_event(pad, event);
+  g_free(stream_id);
+
+  ext = strrchr(entry->name, '.');
+  caps = gst_type_find_helper_for_buffer_with_extension(GST_OBJECT(demux), out,
+                                                        ext ? ext + 1 : NULL, NULL);
+  if (caps == NULL)
+    caps = gst_caps_new_empty_simple("application/octet-stream");
+  GST_DEBUG_OBJECT(demux, "Entry %s has caps %" GST_PTR_FORMAT, entry->name, caps);
+  gst_pad_push_event(pad, gst_event_new_caps(caps));
+  gst_caps_unref(caps);
+
+  gst_element_add_pad(GST_ELEMENT(demux), pad);
+  g_ptr_array_add(demux->srcpads, pad);
+  gst_flow_combiner_add_pad(demux->flowcombiner, pad);
+
+  gst_segment_init(&segment, GST_FORMAT_BYTES);
+  segment.duration = entry->usize;
+  gst_pad_push_event(pad, gst_event_new_segment(&segment));
+
+  tags = gst_tag_list_new(GST_TAG_CONTAINER_FORMAT, "ZIP", GST_TAG_TITLE, entry->name, NULL);
+  if ((mtime = zip_entry_date_time(entry)) != NULL)
+  {
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_DATE_TIME, mtime, NULL);
+    gst_date_time_unref(mtime);
+  }
+  gst_pad_push_event(pad, gst_event_new_tag(tags));
+
+  job->out = NULL;
+  GST_BUFFER_OFFSET(out) = 0;
+  GST_BUFFER_OFFSET_END(out) = entry->usize;
+  flow = gst_pad_push(pad, out);
+  gst_pad_push_event(pad, gst_event_new_eos());
+
+  return gst_flow_combiner_update_pad_flow(demux->flowcombiner, pad, flow);
+}
+
+static void gst_zip_demux_loop(GstPad *pad)
+{
+  GstZipDemux *demux = GST_ZIP_DEMUX(GST_PAD_PARENT(pad));
+  GstFlowReturn flow = GST_FLOW_OK;
+  ZipJob *job;
+
+  if (!demux->have_directory)
+  {
+    if ((flow = gst_zip_demux_read_directory(demux)) != GST_FLOW_OK)
+      goto pause;
+    demux->have_directory = TRUE;
+    if (demux->entries->len == 0)
+    {
+      GST_ELEMENT_ERROR(demux, STREAM, DEMUX, (NULL), ("Archive has no file entries"));
+      flow = GST_FLOW_ERROR;
+      goto pause;
+    }
+  }
+
+  /* keep up to max-in-flight entries decoding ahead of the one pushed next */
+  while (demux->next_job < demux->entries->len &&
+         g_queue_get_length(&demux->jobs) < demux->max_in_flight)
+  {
+    if ((flow = gst_zip_demux_submit(demux)) != GST_FLOW_OK)
+      goto pause;
+  }
+
+  g_mutex_lock(&demux->jobs_lock);
+  while ((job = g_queue_peek_head(&demux->jobs)) != NULL && !job->done)
+    g_cond_wait(&demux->jobs_cond, &demux->jobs_lock);
+  if (job)
+    g_queue_pop_head(&demux->jobs);
+  g_mutex_unlock(&demux->jobs_lock);
+
+  if (job == NULL)
+  {
+    /* every entry was pushed */
+    gst_element_no_more_pads(GST_ELEMENT(demux));
+    flow = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  if (job->error)
+  {
+    GST_ELEMENT_ERROR(demux, STREAM, DECODE, (NULL),
+                      ("Failed to decompress %s: %s", job->entry->name, job->error));
+    zip_job_free(job);
+    flow = GST_FLOW_ERROR;
+    goto pause;
+  }
+  flow = gst_zip_demux_push_entry(demux, job);
+  zip_job_free(job);
+  if (flow != GST_FLOW_OK)
+    goto pause;
+  return;
+
+pause:
+  GST_DEBUG_OBJECT(demux, "Pausing task, reason %s", gst_flow_get_name(flow));
+  gst_pad_pause_task(pad);
+  /* every pad got its EOS after its entry, errors from parsing and decoding
+   * were posted where they happened */
+  if (flow == GST_FLOW_NOT_LINKED || flow == GST_FLOW_NOT_NEGOTIATED)
+    GST_ELEMENT_FLOW_ERROR(demux, flow);
+}
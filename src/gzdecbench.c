@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Microbenchmark of the libgzdeccore hot path, without GStreamer.
+ *
+ *   gzdecbench [-n runs] [-s span] [-b] file...
+ *
+ * Every file is decoded runs times, fed span bytes at a time (the whole
+ * file at once by default) and read out 64 KB at a time, the way gzdec's
+ * stream mode drives the core. -b decodes bzip2 with the built-in decoder
+ * instead of libbz2. Prints the decoded size and the output rate of the
+ * fastest run.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gzdeccore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define OUT_SIZE 65536
+
+static double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t *bench_read_file(const char *path, size_t *size)
+{
+  FILE *f = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long len;
+
+  if (f == NULL)
+    return NULL;
+  if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0)
+  {
+    data = malloc(len ? len : 1);
+    if (data && fread(data, 1, len, f) != (size_t)len)
+    {
+      free(data);
+      data = NULL;
+    }
+    *size = len;
+  }
+  fclose(f);
+  return data;
+}
+
+/* Decode one file, returns the decoded size or -1 */
+static int64_t bench_decode(GzdecCore *core, const uint8_t *in, size_t size, size_t span,
+                            uint8_t *out)
+{
+  size_t pos, n, written;
+  int64_t decoded = 0;
+
+  if (gzdec_core_reset(core) != 0)
+    return -1;
+  for (pos = 0; pos < size; pos += n)
+  {
+    n = size - pos < span ? size - pos : span;
+    gzdec_core_feed(core, in + pos, n);
+    do
+    {
+      if (gzdec_core_read(core, out, OUT_SIZE, &written) == GZDEC_CORE_ERROR)
+      {
+        fprintf(stderr, "decode error: %s\n", gzdec_core_error(core));
+        return -1;
+      }
+      decoded += written;
+    } while (gzdec_core_input_left(core) > 0 || written == OUT_SIZE);
+  }
+  gzdec_core_feed(core, NULL, 0);
+
+  if (!gzdec_core_complete(core))
+  {
+    fprintf(stderr, "truncated input\n");
+    return -1;
+  }
+  return decoded;
+}
+
+int main(int argc, char **argv)
+{
+  GzdecCoreFormat format = GZDEC_CORE_AUTO;
+  GzdecCore *core;
+  uint8_t *in, *out;
+  size_t size, span = 0;
+  int64_t decoded = 0;
+  double start, best;
+  int runs = 5, opt, i, ret = 0;
+
+  while ((opt = getopt(argc, argv, "n:s:b")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      runs = atoi(optarg) > 0 ? atoi(optarg) : 1;
+      break;
+    case 's':
+      span = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      format = GZDEC_CORE_BZIP2_BUILTIN;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n runs] [-s span] [-b] file...\n", argv[0]);
+      return 2;
+    }
+  }
+
+  out = malloc(OUT_SIZE);
+  core = gzdec_core_new(format, GZDEC_CORE_VERIFY_CRC32);
+  if (out == NULL || core == NULL)
+    return 1;
+
+  for (; optind < argc; optind++)
+  {
+    in = bench_read_file(argv[optind], &size);
+    if (in == NULL)
+    {
+      perror(argv[optind]);
+      ret = 1;
+      continue;
+    }
+
+    best = 0;
+    for (i = 0; i < runs; i++)
+    {
+      start = bench_now();
+      decoded = bench_decode(core, in, size, span ? span : size, out);
+      start = bench_now() - start;
+      if (decoded < 0)
+        break;
+      if (i == 0 || start < best)
+        best = start;
+    }
+
+    if (decoded < 0)
+    {
+      fprintf(stderr, "%s: failed\n", argv[optind]);
+      ret = 1;
+    }
+    else
+      printf("%s: %zu -> %lld bytes, %.1f MB/s\n", argv[optind], size, (long long)decoded,
+             best > 0 ? decoded / best / 1e6 : 0.0);
+    free(in);
+  }
+
+  gzdec_core_free(core);
+  free(out);
+  return ret;
+}
@@ -0,0 +1,861 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/* bzip2 decoding without libbz2.
+ *
+ * Huffman codes up to FAST_BITS long, which are nearly all of them, are
+ * decoded with a single table lookup. The inverse Burrows-Wheeler
+ * transform, where libbz2 spends most of its time waiting on cache misses
+ * while it follows one pointer chain through a block of up to 3.6 MB, walks
+ * two independent chains at once instead: forward from the original string
+ * with the T vector and backward with the LF mapping, each producing half
+ * of the block. The two walks' loads overlap, which roughly halves the
+ * time spent stalled. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gzdecbz2.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BZ_MAX_GROUPS 6
+#define BZ_MAX_ALPHA 258
+#define BZ_MAX_CODE_LEN 20
+#define BZ_MAX_SELECTORS 18002
+#define BZ_GROUP_SIZE 50
+#define BZ_RUN_B 1
+#define BZ_MAX_RUN (2 * 1024 * 1024)
+#define BZ_BLOCK_MAGIC 0x314159265359ull
+#define BZ_EOS_MAGIC 0x177245385090ull
+/* codes up to this length are decoded with one table lookup */
+#define FAST_BITS 10
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+typedef enum
+{
+  STATE_STREAM_HEADER,
+  STATE_BLOCK_MAGIC,
+  STATE_BLOCK_HEADER,
+  STATE_MAP_USED,
+  STATE_MAP,
+  STATE_GROUPS,
+  STATE_SELECTORS,
+  STATE_LENS_START,
+  STATE_LENS,
+  STATE_DATA,
+  STATE_OUTPUT,
+  STATE_STREAM_CRC,
+  STATE_DONE
+} GzdecBz2State;
+
+/* Canonical code of one group; first, count and offset are indexed by code
+ * length, fast by the next FAST_BITS input bits and holds sym << 5 | len,
+ * or 0 for longer codes */
+typedef struct
+{
+  uint16_t fast[1 << FAST_BITS];
+  uint32_t first[BZ_MAX_CODE_LEN + 2];
+  uint32_t count[BZ_MAX_CODE_LEN + 2];
+  uint32_t offset[BZ_MAX_CODE_LEN + 2];
+  uint16_t perm[BZ_MAX_ALPHA];
+  int max_len;
+} HuffTable;
+
+struct _GzdecBz2
+{
+  GzdecBz2State state;
+  int verify;
+  const char *error;
+
+  /* input span of the current call, bits are taken MSB first */
+  const uint8_t *in;
+  const uint8_t *in_end;
+  uint64_t bitbuf;
+  unsigned int bitcount;
+
+  /* per block buffers, sized for the stream's block size */
+  uint32_t block_max;
+  uint32_t block_alloc;
+  uint32_t *tt;
+  uint32_t *lf;
+  uint8_t *block;
+
+  /* block header */
+  uint32_t block_crc;
+  uint32_t combined_crc;
+  int randomised;
+  uint32_t orig_ptr;
+  uint16_t used_map;
+  int n_in_use;
+  uint8_t seq_to_unseq[256];
+  int n_groups;
+  int n_selectors;
+  uint8_t selector_mtf[BZ_MAX_GROUPS];
+  uint8_t selectors[BZ_MAX_SELECTORS];
+  uint8_t lens[BZ_MAX_GROUPS][BZ_MAX_ALPHA];
+  HuffTable tables[BZ_MAX_GROUPS];
+  /* loop counters of the header states */
+  int i, j, t;
+  int cur_len;
+
+  /* symbol decoding */
+  int alpha_size;
+  int group_no;
+  int group_left;
+  const HuffTable *table;
+  uint8_t mtf[256];
+  uint32_t unzftab[256];
+  uint32_t nblock;
+  int in_run;
+  uint32_t run_len;
+  uint32_t run_n;
+
+  /* output, undoing the initial run-length coding */
+  uint32_t out_pos;
+  uint32_t crc;
+  uint8_t last;
+  int run;
+  uint32_t rep;
+};
+
+/* CRC-32 with the non-reflected polynomial 0x04c11db7 */
+static const uint32_t bz_crc_table[256] = {
+  0x00000000u, 0x04c11db7u, 0x09823b6eu, 0x0d4326d9u,
+  0x130476dcu, 0x17c56b6bu, 0x1a864db2u, 0x1e475005u,
+  0x2608edb8u, 0x22c9f00fu, 0x2f8ad6d6u, 0x2b4bcb61u,
+  0x350c9b64u, 0x31cd86d3u, 0x3c8ea00au, 0x384fbdbdu,
+  0x4c11db70u, 0x48d0c6c7u, 0x4593e01eu, 0x4152fda9u,
+  0x5f15adacu, 0x5bd4b01bu, 0x569796c2u, 0x52568b75u,
+  0x6a1936c8u, 0x6ed82b7fu, 0x639b0da6u, 0x675a1011u,
+  0x791d4014u, 0x7ddc5da3u, 0x709f7b7au, 0x745e66cdu,
+  0x9823b6e0u, 0x9ce2ab57u, 0x91a18d8eu, 0x95609039u,
+  0x8b27c03cu, 0x8fe6dd8bu, 0x82a5fb52u, 0x8664e6e5u,
+  0xbe2b5b58u, 0xbaea46efu, 0xb7a96036u, 0xb3687d81u,
+  0xad2f2d84u, 0xa9ee3033u, 0xa4ad16eau, 0xa06c0b5du,
+  0xd4326d90u, 0xd0f37027u, 0xddb056feu, 0xd9714b49u,
+  0xc7361b4cu, 0xc3f706fbu, 0xceb42022u, 0xca753d95u,
+  0xf23a8028u, 0xf6fb9d9fu, 0xfbb8bb46u, 0xff79a6f1u,
+  0xe13ef6f4u, 0xe5ffeb43u, 0xe8bccd9au, 0xec7dd02du,
+  0x34867077u, 0x30476dc0u, 0x3d044b19u, 0x39c556aeu,
+  0x278206abu, 0x23431b1cu, 0x2e003dc5u, 0x2ac12072u,
+  0x128e9dcfu, 0x164f8078u, 0x1b0ca6a1u, 0x1fcdbb16u,
+  0x018aeb13u, 0x054bf6a4u, 0x0808d07du, 0x0cc9cdcau,
+  0x7897ab07u, 0x7c56b6b0u, 0x71159069u, 0x75d48ddeu,
+  0x6b93dddbu, 0x6f52c06cu, 0x6211e6b5u, 0x66d0fb02u,
+  0x5e9f46bfu, 0x5a5e5b08u, 0x571d7dd1u, 0x53dc6066u,
+  0x4d9b3063u, 0x495a2dd4u, 0x44190b0du, 0x40d816bau,
+  0xaca5c697u, 0xa864db20u, 0xa527fdf9u, 0xa1e6e04eu,
+  0xbfa1b04bu, 0xbb60adfcu, 0xb6238b25u, 0xb2e29692u,
+  0x8aad2b2fu, 0x8e6c3698u, 0x832f1041u, 0x87ee0df6u,
+  0x99a95df3u, 0x9d684044u, 0x902b669du, 0x94ea7b2au,
+  0xe0b41de7u, 0xe4750050u, 0xe9362689u, 0xedf73b3eu,
+  0xf3b06b3bu, 0xf771768cu, 0xfa325055u, 0xfef34de2u,
+  0xc6bcf05fu, 0xc27dede8u, 0xcf3ecb31u, 0xcbffd686u,
+  0xd5b88683u, 0xd1799b34u, 0xdc3abdedu, 0xd8fba05au,
+  0x690ce0eeu, 0x6dcdfd59u, 0x608edb80u, 0x644fc637u,
+  0x7a089632u, 0x7ec98b85u, 0x738aad5cu, 0x774bb0ebu,
+  0x4f040d56u, 0x4bc510e1u, 0x46863638u, 0x42472b8fu,
+  0x5c007b8au, 0x58c1663du, 0x558240e4u, 0x51435d53u,
+  0x251d3b9eu, 0x21dc2629u, 0x2c9f00f0u, 0x285e1d47u,
+  0x36194d42u, 0x32d850f5u, 0x3f9b762cu, 0x3b5a6b9bu,
+  0x0315d626u, 0x07d4cb91u, 0x0a97ed48u, 0x0e56f0ffu,
+  0x1011a0fau, 0x14d0bd4du, 0x19939b94u, 0x1d528623u,
+  0xf12f560eu, 0xf5ee4bb9u, 0xf8ad6d60u, 0xfc6c70d7u,
+  0xe22b20d2u, 0xe6ea3d65u, 0xeba91bbcu, 0xef68060bu,
+  0xd727bbb6u, 0xd3e6a601u, 0xdea580d8u, 0xda649d6fu,
+  0xc423cd6au, 0xc0e2d0ddu, 0xcda1f604u, 0xc960ebb3u,
+  0xbd3e8d7eu, 0xb9ff90c9u, 0xb4bcb610u, 0xb07daba7u,
+  0xae3afba2u, 0xaafbe615u, 0xa7b8c0ccu, 0xa379dd7bu,
+  0x9b3660c6u, 0x9ff77d71u, 0x92b45ba8u, 0x9675461fu,
+  0x8832161au, 0x8cf30badu, 0x81b02d74u, 0x857130c3u,
+  0x5d8a9099u, 0x594b8d2eu, 0x5408abf7u, 0x50c9b640u,
+  0x4e8ee645u, 0x4a4ffbf2u, 0x470cdd2bu, 0x43cdc09cu,
+  0x7b827d21u, 0x7f436096u, 0x7200464fu, 0x76c15bf8u,
+  0x68860bfdu, 0x6c47164au, 0x61043093u, 0x65c52d24u,
+  0x119b4be9u, 0x155a565eu, 0x18197087u, 0x1cd86d30u,
+  0x029f3d35u, 0x065e2082u, 0x0b1d065bu, 0x0fdc1becu,
+  0x3793a651u, 0x3352bbe6u, 0x3e119d3fu, 0x3ad08088u,
+  0x2497d08du, 0x2056cd3au, 0x2d15ebe3u, 0x29d4f654u,
+  0xc5a92679u, 0xc1683bceu, 0xcc2b1d17u, 0xc8ea00a0u,
+  0xd6ad50a5u, 0xd26c4d12u, 0xdf2f6bcbu, 0xdbee767cu,
+  0xe3a1cbc1u, 0xe760d676u, 0xea23f0afu, 0xeee2ed18u,
+  0xf0a5bd1du, 0xf464a0aau, 0xf9278673u, 0xfde69bc4u,
+  0x89b8fd09u, 0x8d79e0beu, 0x803ac667u, 0x84fbdbd0u,
+  0x9abc8bd5u, 0x9e7d9662u, 0x933eb0bbu, 0x97ffad0cu,
+  0xafb010b1u, 0xab710d06u, 0xa6322bdfu, 0xa2f33668u,
+  0xbcb4666du, 0xb8757bdau, 0xb5365d03u, 0xb1f740b4u,
+};
+
+/* Old encoders flipped the low bit of block bytes at these intervals to
+ * break up repetitive input; the table is part of the format */
+static const uint16_t bz_rnums[512] = {
+  619, 720, 127, 481, 931, 816, 813, 233, 566, 247, 985, 724,
+  205, 454, 863, 491, 741, 242, 949, 214, 733, 859, 335, 708,
+  621, 574, 73, 654, 730, 472, 419, 436, 278, 496, 867, 210,
+  399, 680, 480, 51, 878, 465, 811, 169, 869, 675, 611, 697,
+  867, 561, 862, 687, 507, 283, 482, 129, 807, 591, 733, 623,
+  150, 238, 59, 379, 684, 877, 625, 169, 643, 105, 170, 607,
+  520, 932, 727, 476, 693, 425, 174, 647, 73, 122, 335, 530,
+  442, 853, 695, 249, 445, 515, 909, 545, 703, 919, 874, 474,
+  882, 500, 594, 612, 641, 801, 220, 162, 819, 984, 589, 513,
+  495, 799, 161, 604, 958, 533, 221, 400, 386, 867, 600, 782,
+  382, 596, 414, 171, 516, 375, 682, 485, 911, 276, 98, 553,
+  163, 354, 666, 933, 424, 341, 533, 870, 227, 730, 475, 186,
+  263, 647, 537, 686, 600, 224, 469, 68, 770, 919, 190, 373,
+  294, 822, 808, 206, 184, 943, 795, 384, 383, 461, 404, 758,
+  839, 887, 715, 67, 618, 276, 204, 918, 873, 777, 604, 560,
+  951, 160, 578, 722, 79, 804, 96, 409, 713, 940, 652, 934,
+  970, 447, 318, 353, 859, 672, 112, 785, 645, 863, 803, 350,
+  139, 93, 354, 99, 820, 908, 609, 772, 154, 274, 580, 184,
+  79, 626, 630, 742, 653, 282, 762, 623, 680, 81, 927, 626,
+  789, 125, 411, 521, 938, 300, 821, 78, 343, 175, 128, 250,
+  170, 774, 972, 275, 999, 639, 495, 78, 352, 126, 857, 956,
+  358, 619, 580, 124, 737, 594, 701, 612, 669, 112, 134, 694,
+  363, 992, 809, 743, 168, 974, 944, 375, 748, 52, 600, 747,
+  642, 182, 862, 81, 344, 805, 988, 739, 511, 655, 814, 334,
+  249, 515, 897, 955, 664, 981, 649, 113, 974, 459, 893, 228,
+  433, 837, 553, 268, 926, 240, 102, 654, 459, 51, 686, 754,
+  806, 760, 493, 403, 415, 394, 687, 700, 946, 670, 656, 610,
+  738, 392, 760, 799, 887, 653, 978, 321, 576, 617, 626, 502,
+  894, 679, 243, 440, 680, 879, 194, 572, 640, 724, 926, 56,
+  204, 700, 707, 151, 457, 449, 797, 195, 791, 558, 945, 679,
+  297, 59, 87, 824, 713, 663, 412, 693, 342, 606, 134, 108,
+  571, 364, 631, 212, 174, 643, 304, 329, 343, 97, 430, 751,
+  497, 314, 983, 374, 822, 928, 140, 206, 73, 263, 980, 736,
+  876, 478, 430, 305, 170, 514, 364, 692, 829, 82, 855, 953,
+  676, 246, 369, 970, 294, 750, 807, 827, 150, 790, 288, 923,
+  804, 378, 215, 828, 592, 281, 565, 555, 710, 82, 896, 831,
+  547, 261, 524, 462, 293, 465, 502, 56, 661, 821, 976, 991,
+  658, 869, 905, 758, 745, 193, 768, 550, 608, 933, 378, 286,
+  215, 979, 792, 961, 61, 688, 793, 644, 986, 403, 106, 366,
+  905, 644, 372, 567, 466, 434, 645, 210, 389, 550, 919, 135,
+  780, 773, 635, 389, 707, 100, 626, 958, 165, 504, 920, 176,
+  193, 713, 857, 265, 203, 50, 668, 108, 645, 990, 626, 197,
+  510, 357, 358, 850, 858, 364, 936, 638,
+};
+
+static uint32_t bz_crc(uint32_t crc, const uint8_t *data, size_t size)
+{
+  while (size--)
+    crc = (crc << 8) ^ bz_crc_table[(crc >> 24) ^ *data++];
+  return crc;
+}
+
+static GzdecBz2Status fail(GzdecBz2 *bz, const char *error)
+{
+  bz->error = error;
+  return GZDEC_BZ2_ERROR;
+}
+
+static void refill(GzdecBz2 *bz)
+{
+  while (bz->bitcount <= 56 && bz->in < bz->in_end)
+  {
+    bz->bitbuf = (bz->bitbuf << 8) | *bz->in++;
+    bz->bitcount += 8;
+  }
+}
+
+/* Takes only the bytes needed, so nothing past the end of a stream is
+ * consumed */
+static int need(GzdecBz2 *bz, unsigned int n)
+{
+  while (bz->bitcount < n && bz->in < bz->in_end)
+  {
+    bz->bitbuf = (bz->bitbuf << 8) | *bz->in++;
+    bz->bitcount += 8;
+  }
+  return bz->bitcount >= n;
+}
+
+/* Next n bits, zero padded if fewer are buffered */
+static uint32_t peek(GzdecBz2 *bz, unsigned int n)
+{
+  uint64_t v;
+
+  if (bz->bitcount >= n)
+    v = bz->bitbuf >> (bz->bitcount - n);
+  else
+    v = bz->bitbuf << (n - bz->bitcount);
+  return (uint32_t)(v & ((1ull << n) - 1));
+}
+
+static uint32_t get(GzdecBz2 *bz, unsigned int n)
+{
+  uint32_t v = peek(bz, n);
+
+  bz->bitcount -= n;
+  return v;
+}
+
+#define NEED(bz, n)          \
+  do                         \
+  {                          \
+    if (!need(bz, n))        \
+      return GZDEC_BZ2_OK;   \
+  } while (0)
+
+static int build_table(HuffTable *t, const uint8_t *lens, int alpha_size)
+{
+  uint32_t code = 0, next[BZ_MAX_CODE_LEN + 2], fill, k, c;
+  int len, i;
+
+  memset(t->count, 0, sizeof(t->count));
+  for (i = 0; i < alpha_size; i++)
+    t->count[lens[i]]++;
+
+  t->max_len = 0;
+  t->offset[1] = 0;
+  for (len = 1; len <= BZ_MAX_CODE_LEN; len++)
+  {
+    t->first[len] = code;
+    t->offset[len + 1] = t->offset[len] + t->count[len];
+    code += t->count[len];
+    /* over-subscribed */
+    if (code > (1u << len))
+      return -1;
+    code <<= 1;
+    if (t->count[len])
+      t->max_len = len;
+  }
+
+  /* symbols sorted by code length, then by value, like the encoder */
+  memcpy(next, t->offset, sizeof(next));
+  for (i = 0; i < alpha_size; i++)
+    t->perm[next[lens[i]]++] = i;
+
+  memset(t->fast, 0, sizeof(t->fast));
+  for (len = 1; len <= FAST_BITS; len++)
+  {
+    fill = 1u << (FAST_BITS - len);
+    for (k = 0; k < t->count[len]; k++)
+    {
+      uint16_t entry = (uint16_t)(t->perm[t->offset[len] + k] << 5 | len);
+      uint16_t *slot = t->fast + ((t->first[len] + k) << (FAST_BITS - len));
+
+      /* every FAST_BITS pattern starting with this code */
+      for (c = 0; c < fill; c++)
+        slot[c] = entry;
+    }
+  }
+  return 0;
+}
+
+/* Returns the symbol, -1 for an invalid code or -2 if more input is needed */
+static int decode_symbol(GzdecBz2 *bz, const HuffTable *t)
+{
+  uint32_t v = peek(bz, BZ_MAX_CODE_LEN), code = 0;
+  uint16_t entry = t->fast[v >> (BZ_MAX_CODE_LEN - FAST_BITS)];
+  int len, sym;
+
+  if (entry)
+  {
+    len = entry & 31;
+    sym = entry >> 5;
+  }
+  else
+  {
+    for (len = FAST_BITS + 1; len <= t->max_len; len++)
+    {
+      code = v >> (BZ_MAX_CODE_LEN - len);
+      if (code - t->first[len] < t->count[len])
+        break;
+    }
+    if (len > t->max_len)
+      return bz->bitcount < (unsigned int)t->max_len ? -2 : -1;
+    sym = t->perm[t->offset[len] + code - t->first[len]];
+  }
+  if ((unsigned int)len > bz->bitcount)
+    return -2;
+  bz->bitcount -= len;
+  return sym;
+}
+
+static void start_block_data(GzdecBz2 *bz)
+{
+  int i;
+
+  for (i = 0; i < bz->n_in_use; i++)
+    bz->mtf[i] = bz->seq_to_unseq[i];
+  memset(bz->unzftab, 0, sizeof(bz->unzftab));
+  bz->alpha_size = bz->n_in_use + 2;
+  bz->nblock = 0;
+  bz->group_no = -1;
+  bz->group_left = 0;
+  bz->in_run = 0;
+}
+
+static int flush_run(GzdecBz2 *bz)
+{
+  uint8_t uc = bz->mtf[0];
+  uint32_t *tt = bz->tt + bz->nblock, i;
+
+  bz->in_run = 0;
+  if (bz->run_len > bz->block_max - bz->nblock)
+    return -1;
+  bz->unzftab[uc] += bz->run_len;
+  for (i = 0; i < bz->run_len; i++)
+    tt[i] = uc;
+  bz->nblock += bz->run_len;
+  return 0;
+}
+
+/* Inverse BWT of the block into bz->block, in text order */
+static void undo_bwt(GzdecBz2 *bz)
+{
+  uint32_t cftab[256], sum = 0, i, j, fwd, bwd, e1, e2, half;
+  uint32_t *tt = bz->tt, *lf = bz->lf;
+  uint8_t *block = bz->block;
+  uint32_t n = bz->nblock;
+  int c;
+
+  for (c = 0; c < 256; c++)
+  {
+    cftab[c] = sum;
+    sum += bz->unzftab[c];
+  }
+
+  /* tt[LF(i)] gets i in its upper bits, which makes it the T vector, and
+   * lf[i] keeps LF(i); the low byte of both is the BWT output at that
+   * index */
+  for (i = 0; i < n; i++)
+  {
+    uint8_t uc = tt[i] & 0xff;
+
+    j = cftab[uc]++;
+    tt[j] |= i << 8;
+    lf[i] = (j << 8) | uc;
+  }
+
+  /* text[k] is at T^(k+1)(orig_ptr) and text[n-1-k] at LF^k(orig_ptr) */
+  fwd = tt[bz->orig_ptr] >> 8;
+  bwd = bz->orig_ptr;
+  half = n / 2;
+  for (i = 0; i < half; i++)
+  {
+    e1 = tt[fwd];
+    e2 = lf[bwd];
+    fwd = e1 >> 8;
+    bwd = e2 >> 8;
+    /* start both next loads before the stores below */
+    PREFETCH(&tt[fwd]);
+    PREFETCH(&lf[bwd]);
+    block[i] = (uint8_t)e1;
+    block[n - 1 - i] = (uint8_t)e2;
+  }
+  if (n & 1)
+    block[half] = (uint8_t)tt[fwd];
+}
+
+/* Undo the bit flips of a randomised block, in text order */
+static void derandomise(GzdecBz2 *bz)
+{
+  uint32_t i, to_go = 0, pos = 0;
+
+  for (i = 0; i < bz->nblock; i++)
+  {
+    if (to_go == 0)
+    {
+      to_go = bz_rnums[pos];
+      pos = (pos + 1) % 512;
+    }
+    if (--to_go == 1)
+      bz->block[i] ^= 1;
+  }
+}
+
+static int alloc_blocks(GzdecBz2 *bz, uint32_t block_max)
+{
+  bz->block_max = block_max;
+  if (block_max <= bz->block_alloc)
+    return 0;
+
+  free(bz->tt);
+  free(bz->lf);
+  free(bz->block);
+  bz->tt = malloc(block_max * sizeof(uint32_t));
+  bz->lf = malloc(block_max * sizeof(uint32_t));
+  bz->block = malloc(block_max);
+  if (bz->tt == NULL || bz->lf == NULL || bz->block == NULL)
+  {
+    bz->block_alloc = 0;
+    return -1;
+  }
+  bz->block_alloc = block_max;
+  return 0;
+}
+
+GzdecBz2 *gzdec_bz2_new(void)
+{
+  GzdecBz2 *bz = calloc(1, sizeof(GzdecBz2));
+
+  if (bz == NULL)
+    return NULL;
+  bz->verify = 1;
+  gzdec_bz2_reset(bz);
+  return bz;
+}
+
+void gzdec_bz2_free(GzdecBz2 *bz)
+{
+  if (bz == NULL)
+    return;
+  free(bz->tt);
+  free(bz->lf);
+  free(bz->block);
+  free(bz);
+}
+
+void gzdec_bz2_reset(GzdecBz2 *bz)
+{
+  bz->state = STATE_STREAM_HEADER;
+  bz->error = NULL;
+  bz->bitbuf = 0;
+  bz->bitcount = 0;
+  bz->combined_crc = 0;
+}
+
+void gzdec_bz2_set_verify(GzdecBz2 *bz, int verify)
+{
+  bz->verify = verify;
+}
+
+const char *gzdec_bz2_error(GzdecBz2 *bz)
+{
+  return bz->error;
+}
+
+static GzdecBz2Status decode(GzdecBz2 *bz, uint8_t *out, size_t out_size, size_t *written)
+{
+  uint64_t magic;
+  uint8_t *o, *end;
+  uint32_t crc;
+  int sym;
+
+  while (1)
+  {
+    switch (bz->state)
+    {
+    case STATE_STREAM_HEADER:
+      NEED(bz, 32);
+      magic = get(bz, 32);
+      if ((magic >> 8) != 0x425a68 || (magic & 0xff) < '1' || (magic & 0xff) > '9')
+        return fail(bz, "not in bzip2 format");
+      if (alloc_blocks(bz, ((magic & 0xff) - '0') * 100000) != 0)
+        return fail(bz, "out of memory");
+      bz->state = STATE_BLOCK_MAGIC;
+      break;
+
+    case STATE_BLOCK_MAGIC:
+      NEED(bz, 48);
+      magic = (uint64_t)get(bz, 24) << 24;
+      magic |= get(bz, 24);
+      if (magic == BZ_EOS_MAGIC)
+      {
+        bz->state = STATE_STREAM_CRC;
+        break;
+      }
+      if (magic != BZ_BLOCK_MAGIC)
+        return fail(bz, "invalid bzip2 data");
+      bz->state = STATE_BLOCK_HEADER;
+      break;
+
+    case STATE_BLOCK_HEADER:
+      NEED(bz, 57);
+      bz->block_crc = get(bz, 32);
+      bz->randomised = get(bz, 1);
+      bz->orig_ptr = get(bz, 24);
+      bz->state = STATE_MAP_USED;
+      break;
+
+    case STATE_MAP_USED:
+      NEED(bz, 16);
+      bz->used_map = get(bz, 16);
+      bz->n_in_use = 0;
+      bz->i = 0;
+      bz->state = STATE_MAP;
+      break;
+
+    case STATE_MAP:
+      for (; bz->i < 16; bz->i++)
+      {
+        uint32_t bits;
+
+        if (!(bz->used_map & (0x8000 >> bz->i)))
+          continue;
+        NEED(bz, 16);
+        bits = get(bz, 16);
+        for (bz->j = 0; bz->j < 16; bz->j++)
+          if (bits & (0x8000 >> bz->j))
+            bz->seq_to_unseq[bz->n_in_use++] = bz->i * 16 + bz->j;
+      }
+      if (bz->n_in_use == 0)
+        return fail(bz, "invalid bzip2 data");
+      bz->state = STATE_GROUPS;
+      break;
+
+    case STATE_GROUPS:
+      NEED(bz, 18);
+      bz->n_groups = get(bz, 3);
+      bz->n_selectors = get(bz, 15);
+      if (bz->n_groups < 2 || bz->n_groups > BZ_MAX_GROUPS || bz->n_selectors < 1)
+        return fail(bz, "invalid bzip2 data");
+      for (bz->i = 0; bz->i < bz->n_groups; bz->i++)
+        bz->selector_mtf[bz->i] = bz->i;
+      bz->i = 0;
+      bz->j = 0;
+      bz->state = STATE_SELECTORS;
+      break;
+
+    case STATE_SELECTORS:
+      /* unary coded, move-to-front transformed */
+      while (bz->i < bz->n_selectors)
+      {
+        uint8_t sel;
+
+        NEED(bz, 1);
+        if (get(bz, 1))
+        {
+          if (++bz->j >= bz->n_groups)
+            return fail(bz, "invalid bzip2 data");
+          continue;
+        }
+        sel = bz->selector_mtf[bz->j];
+        memmove(bz->selector_mtf + 1, bz->selector_mtf, bz->j);
+        bz->selector_mtf[0] = sel;
+        /* like libbz2, selectors past the maximum are read and dropped */
+        if (bz->i < BZ_MAX_SELECTORS)
+          bz->selectors[bz->i] = sel;
+        bz->i++;
+        bz->j = 0;
+      }
+      if (bz->n_selectors > BZ_MAX_SELECTORS)
+        bz->n_selectors = BZ_MAX_SELECTORS;
+      bz->t = 0;
+      bz->state = STATE_LENS_START;
+      break;
+
+    case STATE_LENS_START:
+      NEED(bz, 5);
+      bz->cur_len = get(bz, 5);
+      bz->i = 0;
+      bz->state = STATE_LENS;
+      break;
+
+    case STATE_LENS:
+      /* delta coded: 0 ends a length, 10 increments, 11 decrements */
+      while (bz->i < bz->n_in_use + 2)
+      {
+        if (bz->cur_len < 1 || bz->cur_len > BZ_MAX_CODE_LEN)
+          return fail(bz, "invalid bzip2 data");
+        NEED(bz, 1);
+        if (peek(bz, 1) == 0)
+        {
+          get(bz, 1);
+          bz->lens[bz->t][bz->i++] = bz->cur_len;
+          continue;
+        }
+        NEED(bz, 2);
+        bz->cur_len += (get(bz, 2) & 1) ? -1 : 1;
+      }
+      if (build_table(&bz->tables[bz->t], bz->lens[bz->t], bz->n_in_use + 2) != 0)
+        return fail(bz, "invalid bzip2 data");
+      if (++bz->t < bz->n_groups)
+      {
+        bz->state = STATE_LENS_START;
+        break;
+      }
+      start_block_data(bz);
+      bz->state = STATE_DATA;
+      break;
+
+    case STATE_DATA:
+      while (1)
+      {
+        if (bz->group_left == 0)
+        {
+          if (++bz->group_no >= bz->n_selectors)
+            return fail(bz, "invalid bzip2 data");
+          bz->table = &bz->tables[bz->selectors[bz->group_no]];
+          bz->group_left = BZ_GROUP_SIZE;
+        }
+        refill(bz);
+        sym = decode_symbol(bz, bz->table);
+        if (sym == -2)
+          return GZDEC_BZ2_OK;
+        if (sym < 0)
+          return fail(bz, "invalid bzip2 data");
+        bz->group_left--;
+
+        /* RUNA and RUNB give the repeat count of the front byte in
+         * bijective base 2 */
+        if (sym <= BZ_RUN_B)
+        {
+          if (!bz->in_run)
+          {
+            bz->in_run = 1;
+            bz->run_len = 0;
+            bz->run_n = 1;
+          }
+          if (bz->run_n >= BZ_MAX_RUN)
+            return fail(bz, "invalid bzip2 data");
+          bz->run_len += (sym + 1) * bz->run_n;
+          bz->run_n <<= 1;
+          continue;
+        }
+        if (bz->in_run && flush_run(bz) != 0)
+          return fail(bz, "invalid bzip2 data");
+        if (sym == bz->alpha_size - 1)
+          break;
+        if (bz->nblock >= bz->block_max)
+          return fail(bz, "invalid bzip2 data");
+
+        {
+          int nn = sym - 1;
+          uint8_t uc = bz->mtf[nn];
+
+          memmove(bz->mtf + 1, bz->mtf, nn);
+          bz->mtf[0] = uc;
+          bz->unzftab[uc]++;
+          bz->tt[bz->nblock++] = uc;
+        }
+      }
+      if (bz->orig_ptr >= bz->nblock)
+        return fail(bz, "invalid bzip2 data");
+      undo_bwt(bz);
+      if (bz->randomised)
+        derandomise(bz);
+      bz->out_pos = 0;
+      bz->crc = 0xffffffff;
+      bz->run = 0;
+      bz->rep = 0;
+      bz->state = STATE_OUTPUT;
+      break;
+
+    case STATE_OUTPUT:
+      o = out + *written;
+      end = out + out_size;
+      while (o < end)
+      {
+        uint8_t b;
+
+        if (bz->rep > 0)
+        {
+          size_t n = (size_t)(end - o) < bz->rep ? (size_t)(end - o) : bz->rep;
+
+          memset(o, bz->last, n);
+          o += n;
+          bz->rep -= n;
+          continue;
+        }
+        if (bz->out_pos == bz->nblock)
+          break;
+        b = bz->block[bz->out_pos++];
+        /* four equal bytes are followed by a repeat count */
+        if (bz->run == 4)
+        {
+          bz->rep = b;
+          bz->run = 0;
+          continue;
+        }
+        if (b != bz->last || bz->run == 0)
+        {
+          bz->last = b;
+          bz->run = 1;
+        }
+        else
+          bz->run++;
+        *o++ = b;
+      }
+      if (bz->verify)
+        bz->crc = bz_crc(bz->crc, out + *written, o - (out + *written));
+      *written = o - out;
+      if (bz->out_pos < bz->nblock || bz->rep > 0)
+        return GZDEC_BZ2_OK;
+
+      crc = ~bz->crc;
+      if (bz->verify && crc != bz->block_crc)
+        return fail(bz, "CRC mismatch");
+      bz->combined_crc = ((bz->combined_crc << 1) | (bz->combined_crc >> 31)) ^ bz->block_crc;
+      bz->state = STATE_BLOCK_MAGIC;
+      break;
+
+    case STATE_STREAM_CRC:
+      NEED(bz, 32);
+      crc = get(bz, 32);
+      if (bz->verify && crc != bz->combined_crc)
+        return fail(bz, "CRC mismatch");
+      /* the stream is padded to a whole byte */
+      bz->bitcount = 0;
+      bz->state = STATE_DONE;
+      return GZDEC_BZ2_STREAM_END;
+
+    case STATE_DONE:
+      return GZDEC_BZ2_STREAM_END;
+    }
+  }
+}
+
+GzdecBz2Status gzdec_bz2_decompress(GzdecBz2 *bz, const uint8_t *in, size_t in_size,
+                                    size_t *consumed, uint8_t *out, size_t out_size,
+                                    size_t *written)
+{
+  GzdecBz2Status status;
+
+  *consumed = 0;
+  *written = 0;
+  if (bz->error)
+    return GZDEC_BZ2_ERROR;
+
+  bz->in = in;
+  bz->in_end = in + in_size;
+  status = decode(bz, out, out_size, written);
+  *consumed = bz->in - in;
+  return status;
+}
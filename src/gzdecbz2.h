@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/* Built-in bzip2 decoder, an alternative to libbz2 used by libgzdeccore.
+ *
+ * Same streaming contract as BZ2_bzDecompress(): any amount of input may
+ * be passed in, and decoding stops when it runs out, when out is full or
+ * at the end of a stream. Input after the end of a stream is left alone.
+ */
+
+#ifndef __GZDEC_BZ2_H__
+#define __GZDEC_BZ2_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _GzdecBz2 GzdecBz2;
+
+typedef enum
+{
+  GZDEC_BZ2_ERROR = -1,
+  GZDEC_BZ2_OK = 0,
+  GZDEC_BZ2_STREAM_END = 1
+} GzdecBz2Status;
+
+GzdecBz2 *gzdec_bz2_new(void);
+void gzdec_bz2_free(GzdecBz2 *bz);
+
+/* Expect the start of a new stream */
+void gzdec_bz2_reset(GzdecBz2 *bz);
+
+/* Block and stream CRCs are checked unless disabled, on by default */
+void gzdec_bz2_set_verify(GzdecBz2 *bz, int verify);
+
+GzdecBz2Status gzdec_bz2_decompress(GzdecBz2 *bz, const uint8_t *in, size_t in_size,
+                                    size_t *consumed, uint8_t *out, size_t out_size,
+                                    size_t *written);
+
+const char *gzdec_bz2_error(GzdecBz2 *bz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GZDEC_BZ2_H__ */
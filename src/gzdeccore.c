@@ -0,0 +1,744 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gzdeccore.h"
+#include "gzdecbz2.h"
+#include "gzdeccrc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+#include <bzlib.h>
+
+/* gzip header flags (RFC 1952) */
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+#define GZIP_FRESERVED 0xe0
+#define GZIP_TRAILER_SIZE 8
+
+#define READ_UINT16_LE(p) ((uint16_t)((p)[0] | ((p)[1] << 8)))
+#define READ_UINT32_LE(p) ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | \
+                           ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+typedef enum
+{
+  STATE_HEADER,
+  STATE_BODY,
+  STATE_TRAILER,
+  STATE_DONE
+} GzdecCoreState;
+
+struct _GzdecCore
+{
+  GzdecCoreFormat format;
+  int auto_detect;
+  GzdecCoreVerify verify;
+  GzdecCoreState state;
+
+  z_stream stream;
+  int z_ready;
+  bz_stream bz_stream;
+  int bz_ready;
+  GzdecBz2 *bz2;
+
+  /* current input span */
+  const uint8_t *in_start;
+  const uint8_t *in;
+  size_t in_left;
+  int flush_points;
+
+  /* gzip header or trailer bytes split across input spans */
+  uint8_t *pending;
+  size_t pending_len;
+  size_t pending_alloc;
+
+  uint32_t crc;
+  uint32_t size;
+  uint32_t members;
+  uint32_t total_members;
+  uint64_t total_in;
+  uint64_t total_out;
+  const char *error;
+
+  char *name;
+  char *comment;
+  GzdecCoreHeader header;
+  int header_changed;
+};
+
+static uint32_t core_crc(GzdecCoreVerify verify, uint32_t crc, const uint8_t *data, size_t size)
+{
+  if (verify == GZDEC_CORE_VERIFY_CRC32_FAST)
+    return gzdec_crc32_fast(crc, data, size);
+  return crc32(crc, data, size);
+}
+
+static int pending_append(GzdecCore *core, const uint8_t *data, size_t size)
+{
+  if (core->pending_len + size > core->pending_alloc)
+  {
+    size_t alloc = core->pending_alloc ? core->pending_alloc : 256;
+    uint8_t *pending;
+
+    while (alloc < core->pending_len + size)
+      alloc *= 2;
+    if ((pending = realloc(core->pending, alloc)) == NULL)
+      return -1;
+    core->pending = pending;
+    core->pending_alloc = alloc;
+  }
+  memcpy(core->pending + core->pending_len, data, size);
+  core->pending_len += size;
+  return 0;
+}
+
+/* gzip strings are ISO 8859-1 */
+static char *latin1_to_utf8(const uint8_t *str)
+{
+  size_t len = strlen((const char *)str), i;
+  char *utf8 = malloc(len * 2 + 1), *p = utf8;
+
+  if (utf8 == NULL)
+    return NULL;
+  for (i = 0; i < len; i++)
+  {
+    if (str[i] < 0x80)
+      *p++ = str[i];
+    else
+    {
+      *p++ = 0xc0 | (str[i] >> 6);
+      *p++ = 0x80 | (str[i] & 0x3f);
+    }
+  }
+  *p = '\0';
+  return utf8;
+}
+
+static int bz_init(GzdecCore *core)
+{
+  if (core->format == GZDEC_CORE_BZIP2_BUILTIN)
+  {
+    if (core->bz2 == NULL && (core->bz2 = gzdec_bz2_new()) == NULL)
+      return -1;
+    gzdec_bz2_reset(core->bz2);
+    gzdec_bz2_set_verify(core->bz2, core->verify != GZDEC_CORE_VERIFY_NONE);
+    return 0;
+  }
+  if (core->bz_ready)
+    BZ2_bzDecompressEnd(&core->bz_stream);
+  memset(&core->bz_stream, 0, sizeof(core->bz_stream));
+  core->bz_ready = BZ2_bzDecompressInit(&core->bz_stream, 0, 0) == BZ_OK;
+  return core->bz_ready ? 0 : -1;
+}
+
+static int z_init(GzdecCore *core)
+{
+  if (core->z_ready)
+    return 0;
+  /* negative window bits: raw deflate, the wrapper is parsed here */
+  core->z_ready = inflateInit2(&core->stream, -MAX_WBITS) == Z_OK;
+  return core->z_ready ? 0 : -1;
+}
+
+static int format_init(GzdecCore *core)
+{
+  if (core->format == GZDEC_CORE_AUTO)
+    return 0;
+  if (core->format == GZDEC_CORE_GZIP || core->format == GZDEC_CORE_DEFLATE)
+    return z_init(core);
+  return bz_init(core);
+}
+
+GzdecCore *gzdec_core_new(GzdecCoreFormat format, GzdecCoreVerify verify)
+{
+  GzdecCore *core = calloc(1, sizeof(GzdecCore));
+
+  if (core == NULL)
+    return NULL;
+  core->format = format;
+  core->auto_detect = format == GZDEC_CORE_AUTO;
+  core->verify = verify;
+  core->state = STATE_HEADER;
+
+  if (format_init(core) != 0)
+  {
+    free(core);
+    return NULL;
+  }
+  return core;
+}
+
+void gzdec_core_free(GzdecCore *core)
+{
+  if (core == NULL)
+    return;
+  if (core->z_ready)
+    inflateEnd(&core->stream);
+  if (core->bz_ready)
+    BZ2_bzDecompressEnd(&core->bz_stream);
+  gzdec_bz2_free(core->bz2);
+  free(core->pending);
+  free(core->name);
+  free(core->comment);
+  free(core);
+}
+
+GzdecCoreFormat gzdec_core_get_format(GzdecCore *core)
+{
+  return core->format;
+}
+
+void gzdec_core_set_verify(GzdecCore *core, GzdecCoreVerify verify)
+{
+  core->verify = verify;
+  if (core->bz2)
+    gzdec_bz2_set_verify(core->bz2, verify != GZDEC_CORE_VERIFY_NONE);
+}
+
+void gzdec_core_set_flush_points(GzdecCore *core, int enable)
+{
+  core->flush_points = enable;
+}
+
+int gzdec_core_reset(GzdecCore *core)
+{
+  core->state = STATE_HEADER;
+  core->in_start = NULL;
+  core->in = NULL;
+  core->in_left = 0;
+  core->pending_len = 0;
+  core->members = 0;
+  core->error = NULL;
+  core->header_changed = 0;
+
+  /* the next file is sniffed again */
+  if (core->auto_detect)
+  {
+    core->format = GZDEC_CORE_AUTO;
+    return 0;
+  }
+  if (core->format == GZDEC_CORE_GZIP || core->format == GZDEC_CORE_DEFLATE)
+    return inflateReset(&core->stream) == Z_OK ? 0 : -1;
+  /* bzlib has no reset, the stream has to be rebuilt */
+  return bz_init(core);
+}
+
+void gzdec_core_feed(GzdecCore *core, const uint8_t *data, size_t size)
+{
+  core->in_start = data;
+  core->in = data;
+  core->in_left = size;
+}
+
+size_t gzdec_core_input_left(GzdecCore *core)
+{
+  return core->in_left;
+}
+
+static void consume(GzdecCore *core, size_t size)
+{
+  core->in += size;
+  core->in_left -= size;
+  core->total_in += size;
+}
+
+/* Returns the header length, 0 if more bytes are needed or -1 if this is
+ * not a gzip header */
+static long parse_header(GzdecCore *core, const uint8_t *data, size_t size)
+{
+  size_t pos = 10, name = 0, comment = 0;
+  const uint8_t *end;
+  uint8_t flags;
+
+  if ((size > 0 && data[0] != 0x1f) || (size > 1 && data[1] != 0x8b) ||
+      (size > 2 && data[2] != Z_DEFLATED) || (size > 3 && (data[3] & GZIP_FRESERVED)))
+    return -1;
+  if (size < pos)
+    return 0;
+  flags = data[3];
+
+  if (flags & GZIP_FEXTRA)
+  {
+    if (size < pos + 2)
+      return 0;
+    pos += 2 + READ_UINT16_LE(data + pos);
+    if (size < pos)
+      return 0;
+  }
+  if (flags & GZIP_FNAME)
+  {
+    if ((end = memchr(data + pos, 0, size - pos)) == NULL)
+      return 0;
+    name = pos;
+    pos = end - data + 1;
+  }
+  if (flags & GZIP_FCOMMENT)
+  {
+    if ((end = memchr(data + pos, 0, size - pos)) == NULL)
+      return 0;
+    comment = pos;
+    pos = end - data + 1;
+  }
+  if (flags & GZIP_FHCRC)
+  {
+    if (size < pos + 2)
+      return 0;
+    /* low 16 bits of the CRC-32 of the header */
+    if (core->verify != GZDEC_CORE_VERIFY_NONE &&
+        (core_crc(core->verify, 0, data, pos) & 0xffff) != READ_UINT16_LE(data + pos))
+      return -1;
+    pos += 2;
+  }
+
+  free(core->name);
+  free(core->comment);
+  core->name = name ? latin1_to_utf8(data + name) : NULL;
+  core->comment = comment ? latin1_to_utf8(data + comment) : NULL;
+  core->header.name = core->name;
+  core->header.comment = core->comment;
+  core->header.mtime = READ_UINT32_LE(data + 4);
+  core->header_changed = 1;
+  return (long)pos;
+}
+
+/* Header lengths are not known up front, so a split header is parsed again
+ * every time more bytes arrive (it is at most a few hundred bytes in
+ * practice). Returns the parse result like parse_header(). */
+static long read_header(GzdecCore *core)
+{
+  size_t old = core->pending_len;
+  long len;
+
+  if (old == 0)
+  {
+    len = parse_header(core, core->in, core->in_left);
+    if (len > 0)
+      consume(core, len);
+    if (len != 0)
+      return len;
+  }
+
+  if (pending_append(core, core->in, core->in_left) != 0)
+  {
+    core->error = "out of memory";
+    return -1;
+  }
+  len = parse_header(core, core->pending, core->pending_len);
+  if (len > 0)
+  {
+    /* only the header bytes are taken from the span */
+    consume(core, len - old);
+    core->pending_len = 0;
+  }
+  else if (len == 0)
+  {
+    consume(core, core->in_left);
+  }
+  return len;
+}
+
+/* Collect the trailer, which may be split across input spans */
+static const uint8_t *read_trailer(GzdecCore *core)
+{
+  const uint8_t *data;
+  size_t take;
+
+  if (core->pending_len == 0 && core->in_left >= GZIP_TRAILER_SIZE)
+  {
+    data = core->in;
+    consume(core, GZIP_TRAILER_SIZE);
+    return data;
+  }
+
+  take = GZIP_TRAILER_SIZE - core->pending_len;
+  if (take > core->in_left)
+    take = core->in_left;
+  if (pending_append(core, core->in, take) != 0)
+    return NULL;
+  consume(core, take);
+  return core->pending_len == GZIP_TRAILER_SIZE ? core->pending : NULL;
+}
+
+/* A sync or full flush ends with an empty stored block, 00 00 ff ff, right
+ * at a block boundary. Markers split across input spans are missed. */
+static int at_flush_point(GzdecCore *core)
+{
+  const uint8_t *p = core->in - 4;
+
+  return (core->stream.data_type & 128) && core->in - core->in_start >= 4 &&
+         p[0] == 0x00 && p[1] == 0x00 && p[2] == 0xff && p[3] == 0xff;
+}
+
+/* Whether the header that failed to parse starts like a gzip member */
+static int has_gzip_magic(GzdecCore *core)
+{
+  const uint8_t *data = core->pending_len ? core->pending : core->in;
+  size_t len = core->pending_len ? core->pending_len : core->in_left;
+
+  return len >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+static GzdecCoreStatus read_gzip(GzdecCore *core, uint8_t *out, size_t size, size_t *written)
+{
+  const uint8_t *trailer;
+  size_t produced;
+  long len;
+  int err;
+
+  *written = 0;
+  while (1)
+  {
+    switch (core->state)
+    {
+    case STATE_HEADER:
+      if (core->in_left == 0)
+        return GZDEC_CORE_OK;
+      /* raw deflate has no header and a single stream */
+      if (core->format == GZDEC_CORE_DEFLATE)
+      {
+        core->crc = 0;
+        core->size = 0;
+        core->state = core->members ? STATE_DONE : STATE_BODY;
+        break;
+      }
+      len = read_header(core);
+      if (len == 0)
+        return GZDEC_CORE_OK;
+      if (len < 0)
+      {
+        if (core->members == 0 || core->error)
+        {
+          if (core->error == NULL)
+            core->error = "not in gzip format";
+          return GZDEC_CORE_ERROR;
+        }
+        /* a member that starts with the magic is damaged, not garbage */
+        if (has_gzip_magic(core))
+        {
+          core->error = "corrupt gzip header";
+          return GZDEC_CORE_ERROR;
+        }
+        /* like gzip(1), ignore trailing garbage after the last member */
+        core->pending_len = 0;
+        core->state = STATE_DONE;
+        break;
+      }
+      inflateReset(&core->stream);
+      core->crc = 0;
+      core->size = 0;
+      core->state = STATE_BODY;
+      break;
+
+    case STATE_BODY:
+      if (*written == size)
+        return GZDEC_CORE_OK;
+      core->stream.next_in = (Bytef *)core->in;
+      core->stream.avail_in = core->in_left > UINT32_MAX ? UINT32_MAX : core->in_left;
+      core->stream.next_out = out + *written;
+      core->stream.avail_out = size - *written > UINT32_MAX ? UINT32_MAX : size - *written;
+      len = core->stream.avail_in;
+      produced = core->stream.avail_out;
+      /* Z_BLOCK stops at every block boundary so flushes can be seen */
+      err = inflate(&core->stream, core->flush_points ? Z_BLOCK : Z_NO_FLUSH);
+      produced -= core->stream.avail_out;
+      if (core->verify != GZDEC_CORE_VERIFY_NONE)
+        core->crc = core_crc(core->verify, core->crc, out + *written, produced);
+      core->size += produced;
+      core->total_out += produced;
+      *written += produced;
+      consume(core, len - core->stream.avail_in);
+
+      if (err == Z_STREAM_END)
+      {
+        if (core->format == GZDEC_CORE_DEFLATE)
+        {
+          core->members++;
+          core->total_members++;
+          core->state = STATE_HEADER;
+          return GZDEC_CORE_MEMBER_END;
+        }
+        core->state = STATE_TRAILER;
+        break;
+      }
+      if (err != Z_OK && err != Z_BUF_ERROR)
+      {
+        core->error = core->stream.msg ? core->stream.msg : "invalid deflate data";
+        return GZDEC_CORE_ERROR;
+      }
+      if (core->flush_points && at_flush_point(core))
+        return GZDEC_CORE_FLUSH_POINT;
+      /* more input or output space needed (spans over 4 GB go round again) */
+      if (core->in_left == 0 || *written == size)
+        return GZDEC_CORE_OK;
+      break;
+
+    case STATE_TRAILER:
+      if (core->in_left == 0)
+        return GZDEC_CORE_OK;
+      trailer = read_trailer(core);
+      if (trailer == NULL)
+        return GZDEC_CORE_OK;
+      if (core->verify != GZDEC_CORE_VERIFY_NONE)
+      {
+        if (READ_UINT32_LE(trailer) != core->crc)
+          core->error = "CRC-32 mismatch";
+        else if (READ_UINT32_LE(trailer + 4) != core->size)
+          core->error = "length mismatch";
+      }
+      core->pending_len = 0;
+      if (core->error)
+        return GZDEC_CORE_ERROR;
+      core->members++;
+      core->total_members++;
+      core->state = STATE_HEADER;
+      return GZDEC_CORE_MEMBER_END;
+
+    case STATE_DONE:
+      consume(core, core->in_left);
+      return GZDEC_CORE_OK;
+    }
+  }
+}
+
+/* Runs the built-in decoder, returning libbz2 codes */
+static int read_bzip2_builtin(GzdecCore *core, uint8_t *out, size_t size, size_t *written)
+{
+  GzdecBz2Status status;
+  size_t consumed, produced;
+
+  status = gzdec_bz2_decompress(core->bz2, core->in, core->in_left, &consumed,
+                                out + *written, size - *written, &produced);
+  *written += produced;
+  core->total_out += produced;
+  consume(core, consumed);
+  return status == GZDEC_BZ2_STREAM_END ? BZ_STREAM_END
+         : status == GZDEC_BZ2_OK       ? BZ_OK
+                                        : BZ_DATA_ERROR;
+}
+
+static GzdecCoreStatus read_bzip2(GzdecCore *core, uint8_t *out, size_t size, size_t *written)
+{
+  unsigned int avail_in, avail_out;
+  int err;
+
+  *written = 0;
+  while (1)
+  {
+    switch (core->state)
+    {
+    case STATE_HEADER:
+      if (core->in_left == 0)
+        return GZDEC_CORE_OK;
+      /* another stream follows, or trailing garbage like bzip2(1) ignores */
+      if (core->members > 0)
+      {
+        if (core->in[0] != 'B')
+        {
+          core->state = STATE_DONE;
+          break;
+        }
+        if (bz_init(core) != 0)
+        {
+          core->error = "out of memory";
+          return GZDEC_CORE_ERROR;
+        }
+      }
+      core->state = STATE_BODY;
+      break;
+
+    case STATE_BODY:
+      if (*written == size)
+        return GZDEC_CORE_OK;
+      if (core->bz2)
+        err = read_bzip2_builtin(core, out, size, written);
+      else
+      {
+        avail_in = core->in_left > UINT32_MAX ? UINT32_MAX : core->in_left;
+        avail_out = size - *written > UINT32_MAX ? UINT32_MAX : size - *written;
+        core->bz_stream.next_in = (char *)core->in;
+        core->bz_stream.avail_in = avail_in;
+        core->bz_stream.next_out = (char *)out + *written;
+        core->bz_stream.avail_out = avail_out;
+        err = BZ2_bzDecompress(&core->bz_stream);
+        *written += avail_out - core->bz_stream.avail_out;
+        core->total_out += avail_out - core->bz_stream.avail_out;
+        consume(core, avail_in - core->bz_stream.avail_in);
+      }
+
+      if (err == BZ_STREAM_END)
+      {
+        core->members++;
+        core->total_members++;
+        core->state = STATE_HEADER;
+        return GZDEC_CORE_MEMBER_END;
+      }
+      if (err != BZ_OK)
+      {
+        if (core->bz2)
+          core->error = gzdec_bz2_error(core->bz2);
+        else
+          core->error = err == BZ_DATA_ERROR_MAGIC ? "not in bzip2 format"
+                        : err == BZ_MEM_ERROR      ? "out of memory"
+                                                   : "invalid bzip2 data";
+        return GZDEC_CORE_ERROR;
+      }
+      if (core->in_left == 0 || *written == size)
+        return GZDEC_CORE_OK;
+      break;
+
+    case STATE_TRAILER:
+    case STATE_DONE:
+      consume(core, core->in_left);
+      return GZDEC_CORE_OK;
+    }
+  }
+}
+
+GzdecCoreStatus gzdec_core_read(GzdecCore *core, uint8_t *out, size_t size, size_t *written)
+{
+  size_t dummy;
+
+  if (written == NULL)
+    written = &dummy;
+  if (core->error)
+  {
+    *written = 0;
+    return GZDEC_CORE_ERROR;
+  }
+  if (core->format == GZDEC_CORE_AUTO)
+  {
+    *written = 0;
+    if (core->in_left == 0)
+      return GZDEC_CORE_OK;
+    if (core->in[0] == 0x1f)
+      core->format = GZDEC_CORE_GZIP;
+    else if (core->in[0] == 'B')
+      core->format = GZDEC_CORE_BZIP2;
+    else
+    {
+      core->error = "unknown compression format";
+      return GZDEC_CORE_ERROR;
+    }
+    if (format_init(core) != 0)
+    {
+      core->error = "out of memory";
+      return GZDEC_CORE_ERROR;
+    }
+  }
+  if (core->format == GZDEC_CORE_GZIP || core->format == GZDEC_CORE_DEFLATE)
+    return read_gzip(core, out, size, written);
+  return read_bzip2(core, out, size, written);
+}
+
+int gzdec_core_complete(GzdecCore *core)
+{
+  return core->members > 0 && core->pending_len == 0 &&
+         (core->state == STATE_HEADER || core->state == STATE_DONE);
+}
+
+const GzdecCoreHeader *gzdec_core_pop_header(GzdecCore *core)
+{
+  if (!core->header_changed)
+    return NULL;
+  core->header_changed = 0;
+  return &core->header;
+}
+
+uint32_t gzdec_core_get_crc(GzdecCore *core)
+{
+  return core->crc;
+}
+
+const char *gzdec_core_error(GzdecCore *core)
+{
+  return core->error;
+}
+
+uint64_t gzdec_core_gzip_isize(const uint8_t *trailer, uint64_t file_size)
+{
+  uint64_t isize = READ_UINT32_LE(trailer);
+
+  /* deflate hardly ever shrinks data, only by its headers and the block
+   * overhead of stored data */
+  while (isize + 64 < file_size - file_size / 64)
+    isize += (uint64_t)1 << 32;
+  if (isize > file_size * GZDEC_CORE_MAX_DEFLATE_RATIO)
+    return 0;
+  return isize;
+}
+
+int gzdec_core_gzip_single_member(const uint8_t *data, size_t size)
+{
+  const uint8_t *p, *end = data + size;
+
+  /* every member starts 1f 8b 08 with the reserved flags clear and takes
+   * at least a 10 byte header */
+  for (p = data + 1; end - p >= 10; p++)
+  {
+    p = memchr(p, 0x1f, end - p - 9);
+    if (p == NULL)
+      return 1;
+    if (p[1] == 0x8b && p[2] == 8 && (p[3] & 0xe0) == 0)
+      return 0;
+  }
+  return 1;
+}
+
+void gzdec_core_get_stats(GzdecCore *core, GzdecCoreStats *stats)
+{
+  stats->total_in = core->total_in;
+  stats->total_out = core->total_out;
+  stats->members = core->total_members;
+}
+
+void gzdec_core_reset_stats(GzdecCore *core)
+{
+  core->total_in = 0;
+  core->total_out = 0;
+  core->total_members = 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/* libgzdeccore: the gzip/bzip2 decoding behind the gzdec elements, without
+ * any GStreamer or GLib dependency.
+ *
+ * Input is pushed with gzdec_core_feed() and referenced, not copied, until
+ * it is consumed. Output is pulled with gzdec_core_read() into memory owned
+ * by the caller:
+ *
+ *   core = gzdec_core_new(GZDEC_CORE_GZIP, GZDEC_CORE_VERIFY_CRC32);
+ *   gzdec_core_feed(core, data, size);
+ *   do
+ *   {
+ *     status = gzdec_core_read(core, out, sizeof(out), &written);
+ *     consume(out, written);
+ *   } while (status != GZDEC_CORE_ERROR &&
+ *            (gzdec_core_input_left(core) > 0 || written == sizeof(out)));
+ */
+
+#ifndef __GZDEC_CORE_H__
+#define __GZDEC_CORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _GzdecCore GzdecCore;
+
+/* deflate cannot expand data by more than ~1032:1, anything above is a
+ * bogus size */
+#define GZDEC_CORE_MAX_DEFLATE_RATIO 1032
+/* a bzip2 block of a few dozen bytes can hold ~46MB of runs, ~1.4M:1 */
+#define GZDEC_CORE_MAX_BZIP2_RATIO (2 * 1024 * 1024)
+
+typedef enum
+{
+  GZDEC_CORE_GZIP,
+  /* bzip2 with libbz2 */
+  GZDEC_CORE_BZIP2,
+  /* bzip2 with the built-in decoder, see gzdecbz2.h */
+  GZDEC_CORE_BZIP2_BUILTIN,
+  /* gzip or bzip2 (libbz2), told apart by the first byte of each file */
+  GZDEC_CORE_AUTO,
+  /* a single raw deflate stream without gzip wrapper or checksum, as in
+   * ZIP entries */
+  GZDEC_CORE_DEFLATE
+} GzdecCoreFormat;
+
+typedef enum
+{
+  GZDEC_CORE_VERIFY_NONE,
+  GZDEC_CORE_VERIFY_CRC32,
+  GZDEC_CORE_VERIFY_CRC32_FAST
+} GzdecCoreVerify;
+
+typedef enum
+{
+  /* corrupt input, gzdec_core_error() says why */
+  GZDEC_CORE_ERROR = -1,
+  /* input ran out or the output span is full */
+  GZDEC_CORE_OK = 0,
+  /* a gzip member or bzip2 stream ended, more may follow */
+  GZDEC_CORE_MEMBER_END = 1,
+  /* the sender flushed (Z_SYNC_FLUSH or Z_FULL_FLUSH) here, see
+   * gzdec_core_set_flush_points() */
+  GZDEC_CORE_FLUSH_POINT = 2
+} GzdecCoreStatus;
+
+typedef struct
+{
+  uint64_t total_in;
+  uint64_t total_out;
+  uint32_t members;
+} GzdecCoreStats;
+
+/* Fields of a gzip member header, strings are UTF-8 or NULL */
+typedef struct
+{
+  const char *name;
+  const char *comment;
+  uint32_t mtime;
+} GzdecCoreHeader;
+
+GzdecCore *gzdec_core_new(GzdecCoreFormat format, GzdecCoreVerify verify);
+void gzdec_core_free(GzdecCore *core);
+
+/* With GZDEC_CORE_AUTO, the detected format once input was read */
+GzdecCoreFormat gzdec_core_get_format(GzdecCore *core);
+void gzdec_core_set_verify(GzdecCore *core, GzdecCoreVerify verify);
+/* When enabled, gzdec_core_read() also stops after every deflate sync or
+ * full flush point of a gzip stream. Off by default. */
+void gzdec_core_set_flush_points(GzdecCore *core, int enable);
+
+/* Forget all state and expect the start of a new file. Returns 0 on
+ * success. Stats are kept, see gzdec_core_reset_stats(). */
+int gzdec_core_reset(GzdecCore *core);
+
+/* Queue an input span. It must stay valid until gzdec_core_input_left()
+ * is 0, and replaces whatever was left of the previous span. */
+void gzdec_core_feed(GzdecCore *core, const uint8_t *data, size_t size);
+size_t gzdec_core_input_left(GzdecCore *core);
+
+/* Decode into out. Stops when out is full, the input span is used up or
+ * a member ended. */
+GzdecCoreStatus gzdec_core_read(GzdecCore *core, uint8_t *out, size_t size, size_t *written);
+
+/* Non-zero if everything fed so far ends on a member boundary */
+int gzdec_core_complete(GzdecCore *core);
+
+/* Header of the member being decoded, once after each new header and
+ * NULL otherwise */
+const GzdecCoreHeader *gzdec_core_pop_header(GzdecCore *core);
+
+/* CRC-32 of the output of the current gzip member or raw deflate stream so
+ * far, 0 with GZDEC_CORE_VERIFY_NONE */
+uint32_t gzdec_core_get_crc(GzdecCore *core);
+
+/* Size the ISIZE trailer (the last 4 bytes) of a gzip file of file_size
+ * bytes announces. ISIZE is the size mod 2^32, the high bits are restored
+ * from file_size. 0 if the trailer cannot be right. */
+uint64_t gzdec_core_gzip_isize(const uint8_t *trailer, uint64_t file_size);
+
+/* 1 if the gzip object of size bytes holds a single member, so that its
+ * ISIZE is the size of all of it. 0 if another member may start inside,
+ * which compressed data that merely looks like a header also gives. */
+int gzdec_core_gzip_single_member(const uint8_t *data, size_t size);
+
+const char *gzdec_core_error(GzdecCore *core);
+
+void gzdec_core_get_stats(GzdecCore *core, GzdecCoreStats *stats);
+void gzdec_core_reset_stats(GzdecCore *core);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GZDEC_CORE_H__ */
@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* CRC-32 by carry-less multiplication folding, see Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * The constants are x^n mod P(x) for the bit-reflected gzip polynomial. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gzdeccrc.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define GZDEC_CRC_X86 1
+#include <immintrin.h>
+#endif
+
+typedef uint32_t (*GzdecCrcFunc)(uint32_t crc, const uint8_t *buf, size_t len);
+
+static uint32_t crc32_zlib(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  /* zlib takes a uInt length */
+  while (len > 0)
+  {
+    unsigned int n = len > (1u << 30) ? (1u << 30) : (unsigned int)len;
+    crc = crc32(crc, buf, n);
+    buf += n;
+    len -= n;
+  }
+  return crc;
+}
+
+#ifdef GZDEC_CRC_X86
+
+/* Fold 128 bits into 32 bits and Barrett reduce; x1 holds the folded state */
+__attribute__((target("sse4.1,pclmul")))
+static uint32_t crc32_fold_finish(__m128i x1, const uint8_t *buf, size_t len)
+{
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x2, x5;
+
+  /* remaining 16 byte blocks */
+  while (len >= 16)
+  {
+    x2 = _mm_loadu_si128((const __m128i *)buf);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    buf += 16;
+    len -= 16;
+  }
+
+  /* 128 -> 64 bits */
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_srli_si128(x1, 8);
+  x1 = _mm_xor_si128(x1, x2);
+
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduction to 32 bits */
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+/* Fold four 128 bit lanes x1..x4(consecutive in the message) into one */
+__attribute__((target("sse4.1,pclmul")))
+static __m128i crc32_fold_4x128(__m128i x1, __m128i x2, __m128i x3, __m128i x4)
+{
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  __m128i x5;
+
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+}
+
+/* len >= 64 and a multiple of 16, crc already inverted */
+__attribute__((target("sse4.1,pclmul")))
+static uint32_t crc32_pclmul_blocks(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+  x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+  x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+  x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  buf += 64;
+  len -= 64;
+
+  while (len >= 64)
+  {
+    x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+
+    buf += 64;
+    len -= 64;
+  }
+
+  return crc32_fold_finish(crc32_fold_4x128(x1, x2, x3, x4), buf, len);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  size_t blocks;
+
+  if (len < 64)
+    return crc32_zlib(crc, buf, len);
+
+  blocks = len & ~(size_t)15;
+  crc = ~crc32_pclmul_blocks(~crc, buf, blocks);
+  return crc32_zlib(crc, buf + blocks, len - blocks);
+}
+
+/* Same folding on 512 bit registers, four of them in flight(256 bytes per
+ * iteration); len >= 256 and a multiple of 16, crc already inverted */
+__attribute__((target("avx512f,avx512vl,vpclmulqdq,sse4.1,pclmul")))
+static uint32_t crc32_vpclmul_blocks(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  const __m512i k2048 = _mm512_broadcast_i32x4(_mm_set_epi64x(0x01322d1430, 0x011542778a));
+  const __m512i k512 = _mm512_broadcast_i32x4(_mm_set_epi64x(0x01c6e41596, 0x0154442bd4));
+  __m512i z0, z1, z2, z3;
+
+  z0 = _mm512_loadu_si512((const void *)(buf + 0x00));
+  z1 = _mm512_loadu_si512((const void *)(buf + 0x40));
+  z2 = _mm512_loadu_si512((const void *)(buf + 0x80));
+  z3 = _mm512_loadu_si512((const void *)(buf + 0xc0));
+  z0 = _mm512_xor_si512(z0, _mm512_castsi128_si512(_mm_cvtsi32_si128((int)crc)));
+  buf += 256;
+  len -= 256;
+
+#define FOLD(z, k, next) \
+  _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z, k, 0x00), \
+                             _mm512_clmulepi64_epi128(z, k, 0x11), next, 0x96)
+
+  while (len >= 256)
+  {
+    z0 = FOLD(z0, k2048, _mm512_loadu_si512((const void *)(buf + 0x00)));
+    z1 = FOLD(z1, k2048, _mm512_loadu_si512((const void *)(buf + 0x40)));
+    z2 = FOLD(z2, k2048, _mm512_loadu_si512((const void *)(buf + 0x80)));
+    z3 = FOLD(z3, k2048, _mm512_loadu_si512((const void *)(buf + 0xc0)));
+    buf += 256;
+    len -= 256;
+  }
+
+  /* four 512 bit accumulators into one */
+  z0 = FOLD(z0, k512, z1);
+  z0 = FOLD(z0, k512, z2);
+  z0 = FOLD(z0, k512, z3);
+
+  while (len >= 64)
+  {
+    z0 = FOLD(z0, k512, _mm512_loadu_si512((const void *)buf));
+    buf += 64;
+    len -= 64;
+  }
+#undef FOLD
+
+  return crc32_fold_finish(crc32_fold_4x128(_mm512_extracti32x4_epi32(z0, 0),
+                                              _mm512_extracti32x4_epi32(z0, 1),
+                                              _mm512_extracti32x4_epi32(z0, 2),
+                                              _mm512_extracti32x4_epi32(z0, 3)),
+                            buf, len);
+}
+
+static uint32_t crc32_vpclmul(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  size_t blocks;
+
+  if (len < 256)
+    return crc32_pclmul(crc, buf, len);
+
+  blocks = len & ~(size_t)15;
+  crc = ~crc32_vpclmul_blocks(~crc, buf, blocks);
+  return crc32_zlib(crc, buf + blocks, len - blocks);
+}
+
+#endif /* GZDEC_CRC_X86 */
+
+static GzdecCrcFunc crc32_impl;
+static const char *crc32_impl_name;
+
+static void crc32_select(void)
+{
+  GzdecCrcFunc impl = crc32_zlib;
+  const char *name = "zlib";
+
+#ifdef GZDEC_CRC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+  {
+    impl = crc32_pclmul;
+    name = "pclmulqdq";
+  }
+  if (__builtin_cpu_supports("vpclmulqdq") && __builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512vl"))
+  {
+    impl = crc32_vpclmul;
+    name = "vpclmulqdq";
+  }
+#endif
+
+  /* racing threads all store the same values */
+  crc32_impl_name = name;
+  __atomic_store_n(&crc32_impl, impl, __ATOMIC_RELEASE);
+}
+
+uint32_t gzdec_crc32_fast(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  GzdecCrcFunc impl = __atomic_load_n(&crc32_impl, __ATOMIC_ACQUIRE);
+
+  if (impl == NULL)
+  {
+    crc32_select();
+    impl = crc32_impl;
+  }
+  return impl(crc, buf, len);
+}
+
+const char *gzdec_crc32_fast_impl(void)
+{
+  if (__atomic_load_n(&crc32_impl, __ATOMIC_ACQUIRE) == NULL)
+    crc32_select();
+  return crc32_impl_name;
+}
+
+/* CRC-32C (Castagnoli), bit-reflected polynomial 0x82f63b78 */
+static const uint32_t crc32c_table[256] = {
+  0x00000000u, 0xf26b8303u, 0xe13b70f7u, 0x1350f3f4u,
+  0xc79a971fu, 0x35f1141cu, 0x26a1e7e8u, 0xd4ca64ebu,
+  0x8ad958cfu, 0x78b2dbccu, 0x6be22838u, 0x9989ab3bu,
+  0x4d43cfd0u, 0xbf284cd3u, 0xac78bf27u, 0x5e133c24u,
+  0x105ec76fu, 0xe235446cu, 0xf165b798u, 0x030e349bu,
+  0xd7c45070u, 0x25afd373u, 0x36ff2087u, 0xc494a384u,
+  0x9a879fa0u, 0x68ec1ca3u, 0x7bbcef57u, 0x89d76c54u,
+  0x5d1d08bfu, 0xaf768bbcu, 0xbc267848u, 0x4e4dfb4bu,
+  0x20bd8edeu, 0xd2d60dddu, 0xc186fe29u, 0x33ed7d2au,
+  0xe72719c1u, 0x154c9ac2u, 0x061c6936u, 0xf477ea35u,
+  0xaa64d611u, 0x580f5512u, 0x4b5fa6e6u, 0xb93425e5u,
+  0x6dfe410eu, 0x9f95c20du, 0x8cc531f9u, 0x7eaeb2fau,
+  0x30e349b1u, 0xc288cab2u, 0xd1d83946u, 0x23b3ba45u,
+  0xf779deaeu, 0x05125dadu, 0x1642ae59u, 0xe4292d5au,
+  0xba3a117eu, 0x4851927du, 0x5b016189u, 0xa96ae28au,
+  0x7da08661u, 0x8fcb0562u, 0x9c9bf696u, 0x6ef07595u,
+  0x417b1dbcu, 0xb3109ebfu, 0xa0406d4bu, 0x522bee48u,
+  0x86e18aa3u, 0x748a09a0u, 0x67dafa54u, 0x95b17957u,
+  0xcba24573u, 0x39c9c670u, 0x2a993584u, 0xd8f2b687u,
+  0x0c38d26cu, 0xfe53516fu, 0xed03a29bu, 0x1f682198u,
+  0x5125dad3u, 0xa34e59d0u, 0xb01eaa24u, 0x42752927u,
+  0x96bf4dccu, 0x64d4cecfu, 0x77843d3bu, 0x85efbe38u,
+  0xdbfc821cu, 0x2997011fu, 0x3ac7f2ebu, 0xc8ac71e8u,
+  0x1c661503u, 0xee0d9600u, 0xfd5d65f4u, 0x0f36e6f7u,
+  0x61c69362u, 0x93ad1061u, 0x80fde395u, 0x72966096u,
+  0xa65c047du, 0x5437877eu, 0x4767748au, 0xb50cf789u,
+  0xeb1fcbadu, 0x197448aeu, 0x0a24bb5au, 0xf84f3859u,
+  0x2c855cb2u, 0xdeeedfb1u, 0xcdbe2c45u, 0x3fd5af46u,
+  0x7198540du, 0x83f3d70eu, 0x90a324fau, 0x62c8a7f9u,
+  0xb602c312u, 0x44694011u, 0x5739b3e5u, 0xa55230e6u,
+  0xfb410cc2u, 0x092a8fc1u, 0x1a7a7c35u, 0xe811ff36u,
+  0x3cdb9bddu, 0xceb018deu, 0xdde0eb2au, 0x2f8b6829u,
+  0x82f63b78u, 0x709db87bu, 0x63cd4b8fu, 0x91a6c88cu,
+  0x456cac67u, 0xb7072f64u, 0xa457dc90u, 0x563c5f93u,
+  0x082f63b7u, 0xfa44e0b4u, 0xe9141340u, 0x1b7f9043u,
+  0xcfb5f4a8u, 0x3dde77abu, 0x2e8e845fu, 0xdce5075cu,
+  0x92a8fc17u, 0x60c37f14u, 0x73938ce0u, 0x81f80fe3u,
+  0x55326b08u, 0xa759e80bu, 0xb4091bffu, 0x466298fcu,
+  0x1871a4d8u, 0xea1a27dbu, 0xf94ad42fu, 0x0b21572cu,
+  0xdfeb33c7u, 0x2d80b0c4u, 0x3ed04330u, 0xccbbc033u,
+  0xa24bb5a6u, 0x502036a5u, 0x4370c551u, 0xb11b4652u,
+  0x65d122b9u, 0x97baa1bau, 0x84ea524eu, 0x7681d14du,
+  0x2892ed69u, 0xdaf96e6au, 0xc9a99d9eu, 0x3bc21e9du,
+  0xef087a76u, 0x1d63f975u, 0x0e330a81u, 0xfc588982u,
+  0xb21572c9u, 0x407ef1cau, 0x532e023eu, 0xa145813du,
+  0x758fe5d6u, 0x87e466d5u, 0x94b49521u, 0x66df1622u,
+  0x38cc2a06u, 0xcaa7a905u, 0xd9f75af1u, 0x2b9cd9f2u,
+  0xff56bd19u, 0x0d3d3e1au, 0x1e6dcdeeu, 0xec064eedu,
+  0xc38d26c4u, 0x31e6a5c7u, 0x22b65633u, 0xd0ddd530u,
+  0x0417b1dbu, 0xf67c32d8u, 0xe52cc12cu, 0x1747422fu,
+  0x49547e0bu, 0xbb3ffd08u, 0xa86f0efcu, 0x5a048dffu,
+  0x8ecee914u, 0x7ca56a17u, 0x6ff599e3u, 0x9d9e1ae0u,
+  0xd3d3e1abu, 0x21b862a8u, 0x32e8915cu, 0xc083125fu,
+  0x144976b4u, 0xe622f5b7u, 0xf5720643u, 0x07198540u,
+  0x590ab964u, 0xab613a67u, 0xb831c993u, 0x4a5a4a90u,
+  0x9e902e7bu, 0x6cfbad78u, 0x7fab5e8cu, 0x8dc0dd8fu,
+  0xe330a81au, 0x115b2b19u, 0x020bd8edu, 0xf0605beeu,
+  0x24aa3f05u, 0xd6c1bc06u, 0xc5914ff2u, 0x37faccf1u,
+  0x69e9f0d5u, 0x9b8273d6u, 0x88d28022u, 0x7ab90321u,
+  0xae7367cau, 0x5c18e4c9u, 0x4f48173du, 0xbd23943eu,
+  0xf36e6f75u, 0x0105ec76u, 0x12551f82u, 0xe03e9c81u,
+  0x34f4f86au, 0xc69f7b69u, 0xd5cf889du, 0x27a40b9eu,
+  0x79b737bau, 0x8bdcb4b9u, 0x988c474du, 0x6ae7c44eu,
+  0xbe2da0a5u, 0x4c4623a6u, 0x5f16d052u, 0xad7d5351u,
+};
+
+static uint32_t crc32c_table_impl(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  crc = ~crc;
+  while (len--)
+    crc = (crc >> 8) ^ crc32c_table[(crc ^ *buf++) & 0xff];
+  return ~crc;
+}
+
+#ifdef GZDEC_CRC_X86
+
+/* SSE 4.2 has an instruction for exactly this polynomial */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  uint64_t c = ~crc;
+  uint64_t v;
+
+  while (len > 0 && ((uintptr_t)buf & 7))
+  {
+    c = _mm_crc32_u8((uint32_t)c, *buf++);
+    len--;
+  }
+  while (len >= 8)
+  {
+    memcpy(&v, buf, 8);
+    c = _mm_crc32_u64(c, v);
+    buf += 8;
+    len -= 8;
+  }
+  while (len--)
+    c = _mm_crc32_u8((uint32_t)c, *buf++);
+  return ~(uint32_t)c;
+}
+
+#endif /* GZDEC_CRC_X86 */
+
+static GzdecCrcFunc crc32c_impl;
+static const char *crc32c_impl_name;
+
+static void crc32c_select(void)
+{
+  GzdecCrcFunc impl = crc32c_table_impl;
+  const char *name = "table";
+
+#ifdef GZDEC_CRC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2"))
+  {
+    impl = crc32c_sse42;
+    name = "sse4.2";
+  }
+#endif
+
+  crc32c_impl_name = name;
+  __atomic_store_n(&crc32c_impl, impl, __ATOMIC_RELEASE);
+}
+
+uint32_t gzdec_crc32c(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  GzdecCrcFunc impl = __atomic_load_n(&crc32c_impl, __ATOMIC_ACQUIRE);
+
+  if (impl == NULL)
+  {
+    crc32c_select();
+    impl = crc32c_impl;
+  }
+  return impl(crc, buf, len);
+}
+
+const char *gzdec_crc32c_impl(void)
+{
+  if (__atomic_load_n(&crc32c_impl, __ATOMIC_ACQUIRE) == NULL)
+    crc32c_select();
+  return crc32c_impl_name;
+}
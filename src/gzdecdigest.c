@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/* SHA-256 uses the SHA extensions (SHA-NI) when the CPU has them, CRC-32C
+ * the SSE 4.2 crc32 instruction, and XXH3 comes from libxxhash, which
+ * vectorizes it itself. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gzdecdigest.h"
+#include "gzdeccrc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_XXHASH
+#include <xxhash.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define GZDEC_SHA_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+typedef void (*GzdecShaFunc) (uint32_t state[8], const uint8_t *data, size_t blocks);
+
+struct _GzdecDigest
+{
+  GzdecDigestType type;
+
+  /* SHA-256 */
+  uint32_t state[8];
+  uint8_t block[64];
+  size_t block_len;
+  uint64_t total;
+
+  uint32_t crc;
+
+#ifdef HAVE_XXHASH
+  XXH3_state_t *xxh3;
+#endif
+};
+
+static const uint32_t sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_init[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void
+sha256_blocks_c(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+  uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+  int i;
+
+  while (blocks--)
+  {
+    for (i = 0; i < 16; i++)
+      w[i] = (uint32_t)data[i * 4] << 24 | (uint32_t)data[i * 4 + 1] << 16 |
+             (uint32_t)data[i * 4 + 2] << 8 | data[i * 4 + 3];
+    for (i = 16; i < 64; i++)
+      w[i] = w[i - 16] + (ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+             w[i - 7] + (ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10));
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+    for (i = 0; i < 64; i++)
+    {
+      t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) +
+           sha256_k[i] + w[i];
+      t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+    data += 64;
+  }
+}
+
+#ifdef GZDEC_SHA_X86
+
+/* Four rounds per step: the message schedule for words 4i..4i+3 comes from
+ * the previous four quads, sha256rnds2 does two rounds at a time on the
+ * state split into ABEF and CDGH halves */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void
+sha256_blocks_shani(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+  const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i abef, cdgh, abef_save, cdgh_save, tmp, msg[4];
+  int i;
+
+  tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+  cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+  abef = _mm_alignr_epi8(tmp, cdgh, 8);
+  cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+  while (blocks--)
+  {
+    abef_save = abef;
+    cdgh_save = cdgh;
+
+    for (i = 0; i < 16; i++)
+    {
+      if (i < 4)
+        msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), bswap);
+      else
+        msg[i & 3] = _mm_sha256msg2_epu32(
+            _mm_add_epi32(_mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]),
+                          _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4)),
+            msg[(i + 3) & 3]);
+      tmp = _mm_add_epi32(msg[i & 3], _mm_loadu_si128((const __m128i *)&sha256_k[i * 4]));
+      cdgh = _mm_sha256rnds2_epu32(cdgh, abef, tmp);
+      abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(tmp, 0x0e));
+    }
+
+    abef = _mm_add_epi32(abef, abef_save);
+    cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    data += 64;
+  }
+
+  tmp = _mm_shuffle_epi32(abef, 0x1b);
+  cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+  _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, cdgh, 0xf0));
+  _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+#endif /* GZDEC_SHA_X86 */
+
+static GzdecShaFunc sha256_impl;
+static const char *sha256_impl_name;
+
+static void
+sha256_select(void)
+{
+  GzdecShaFunc impl = sha256_blocks_c;
+  const char *name = "c";
+
+#ifdef GZDEC_SHA_X86
+  unsigned int eax, ebx, ecx, edx;
+
+  __builtin_cpu_init();
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA) &&
+      __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3"))
+  {
+    impl = sha256_blocks_shani;
+    name = "sha-ni";
+  }
+#endif
+
+  /* racing threads all store the same values */
+  sha256_impl_name = name;
+  __atomic_store_n(&sha256_impl, impl, __ATOMIC_RELEASE);
+}
+
+static GzdecShaFunc
+sha256_get_impl(void)
+{
+  GzdecShaFunc impl = __atomic_load_n(&sha256_impl, __ATOMIC_ACQUIRE);
+
+  if (impl == NULL)
+  {
+    sha256_select();
+    impl = sha256_impl;
+  }
+  return impl;
+}
+
+static void
+sha256_update(GzdecDigest *digest, const uint8_t *buf, size_t len)
+{
+  GzdecShaFunc blocks = sha256_get_impl();
+  size_t take;
+
+  digest->total += len;
+  if (digest->block_len > 0)
+  {
+    take = 64 - digest->block_len < len ? 64 - digest->block_len : len;
+    memcpy(digest->block + digest->block_len, buf, take);
+    digest->block_len += take;
+    buf += take;
+    len -= take;
+    if (digest->block_len < 64)
+      return;
+    blocks(digest->state, digest->block, 1);
+    digest->block_len = 0;
+  }
+  /* whole blocks straight from the caller's memory */
+  if (len >= 64)
+  {
+    blocks(digest->state, buf, len / 64);
+    buf += len & ~(size_t)63;
+    len &= 63;
+  }
+  memcpy(digest->block, buf, len);
+  digest->block_len = len;
+}
+
+static void
+sha256_finish(GzdecDigest *digest, char *hex)
+{
+  GzdecShaFunc blocks = sha256_get_impl();
+  uint64_t bits = digest->total * 8;
+  int i;
+
+  digest->block[digest->block_len++] = 0x80;
+  if (digest->block_len > 56)
+  {
+    memset(digest->block + digest->block_len, 0, 64 - digest->block_len);
+    blocks(digest->state, digest->block, 1);
+    digest->block_len = 0;
+  }
+  memset(digest->block + digest->block_len, 0, 56 - digest->block_len);
+  for (i = 0; i < 8; i++)
+    digest->block[56 + i] = (uint8_t)(bits >> (56 - i * 8));
+  blocks(digest->state, digest->block, 1);
+
+  for (i = 0; i < 8; i++)
+    sprintf(hex + i * 8, "%08x", digest->state[i]);
+}
+
+GzdecDigest *
+gzdec_digest_new(GzdecDigestType type)
+{
+  GzdecDigest *digest;
+
+#ifndef HAVE_XXHASH
+  if (type == GZDEC_DIGEST_XXH3)
+    return NULL;
+#endif
+  if (type == GZDEC_DIGEST_NONE || (digest = calloc(1, sizeof(GzdecDigest))) == NULL)
+    return NULL;
+  digest->type = type;
+
+#ifdef HAVE_XXHASH
+  if (type == GZDEC_DIGEST_XXH3 && (digest->xxh3 = XXH3_createState()) == NULL)
+  {
+    free(digest);
+    return NULL;
+  }
+#endif
+
+  gzdec_digest_reset(digest);
+  return digest;
+}
+
+void
+gzdec_digest_free(GzdecDigest *digest)
+{
+  if (digest == NULL)
+    return;
+#ifdef HAVE_XXHASH
+  if (digest->xxh3)
+    XXH3_freeState(digest->xxh3);
+#endif
+  free(digest);
+}
+
+void
+gzdec_digest_reset(GzdecDigest *digest)
+{
+  switch (digest->type)
+  {
+  case GZDEC_DIGEST_SHA256:
+    memcpy(digest->state, sha256_init, sizeof(sha256_init));
+    digest->block_len = 0;
+    digest->total = 0;
+    break;
+  case GZDEC_DIGEST_CRC32C:
+    digest->crc = 0;
+    break;
+  case GZDEC_DIGEST_XXH3:
+#ifdef HAVE_XXHASH
+    XXH3_64bits_reset(digest->xxh3);
+#endif
+    break;
+  default:
+    break;
+  }
+}
+
+void
+gzdec_digest_update(GzdecDigest *digest, const uint8_t *buf, size_t len)
+{
+  switch (digest->type)
+  {
+  case GZDEC_DIGEST_SHA256:
+    sha256_update(digest, buf, len);
+    break;
+  case GZDEC_DIGEST_CRC32C:
+    digest->crc = gzdec_crc32c(digest->crc, buf, len);
+    break;
+  case GZDEC_DIGEST_XXH3:
+#ifdef HAVE_XXHASH
+    XXH3_64bits_update(digest->xxh3, buf, len);
+#endif
+    break;
+  default:
+    break;
+  }
+}
+
+void
+gzdec_digest_finish(GzdecDigest *digest, char hex[GZDEC_DIGEST_HEX_SIZE])
+{
+  hex[0] = '\0';
+  switch (digest->type)
+  {
+  case GZDEC_DIGEST_SHA256:
+    sha256_finish(digest, hex);
+    break;
+  case GZDEC_DIGEST_CRC32C:
+    sprintf(hex, "%08x", digest->crc);
+    break;
+  case GZDEC_DIGEST_XXH3:
+#ifdef HAVE_XXHASH
+    sprintf(hex, "%016llx", (unsigned long long)XXH3_64bits_digest(digest->xxh3));
+#endif
+    break;
+  default:
+    break;
+  }
+}
+
+const char *
+gzdec_digest_impl(GzdecDigestType type)
+{
+  switch (type)
+  {
+  case GZDEC_DIGEST_SHA256:
+    sha256_get_impl();
+    return sha256_impl_name;
+  case GZDEC_DIGEST_CRC32C:
+    return gzdec_crc32c_impl();
+  case GZDEC_DIGEST_XXH3:
+    return "libxxhash";
+  default:
+    return "none";
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/* Digests of the decoded output, computed while it is still in cache */
+
+#ifndef __GZDEC_DIGEST_H__
+#define __GZDEC_DIGEST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _GzdecDigest GzdecDigest;
+
+typedef enum
+{
+  GZDEC_DIGEST_NONE,
+  /* 64-bit XXH3, needs libxxhash at build time */
+  GZDEC_DIGEST_XXH3,
+  GZDEC_DIGEST_SHA256,
+  GZDEC_DIGEST_CRC32C
+} GzdecDigestType;
+
+/* Room for the longest hex digest and its terminator */
+#define GZDEC_DIGEST_HEX_SIZE 65
+
+/* NULL if the type is not available in this build */
+GzdecDigest *gzdec_digest_new(GzdecDigestType type);
+void gzdec_digest_free(GzdecDigest *digest);
+
+void gzdec_digest_reset(GzdecDigest *digest);
+void gzdec_digest_update(GzdecDigest *digest, const uint8_t *buf, size_t len);
+/* Writes the lowercase hex digest of everything since the last reset */
+void gzdec_digest_finish(GzdecDigest *digest, char hex[GZDEC_DIGEST_HEX_SIZE]);
+
+/* Name of the implementation picked for this CPU, for debug output */
+const char *gzdec_digest_impl(GzdecDigestType type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GZDEC_DIGEST_H__ */
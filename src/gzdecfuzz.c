@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2023 Lenin <<ttvleninn@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Fuzz driver for libgzdeccore.
+ *
+ * Built with -DGZDEC_LIBFUZZER and -fsanitize=fuzzer it is a libFuzzer
+ * target, otherwise main() runs every file named on the command line
+ * through it once, to replay a crash or check a corpus. The first input
+ * byte picks the format and verify mode, the second seeds the sizes of the
+ * input spans and output reads, so arbitrary feed boundaries and tiny
+ * output spans are exercised along with the data itself.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gzdeccore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* decompression bombs would only slow the fuzzer down */
+#define MAX_DECODED (64 * 1024 * 1024)
+
+static const GzdecCoreFormat fuzz_formats[] = {
+    GZDEC_CORE_GZIP,
+    GZDEC_CORE_BZIP2,
+    GZDEC_CORE_BZIP2_BUILTIN,
+    GZDEC_CORE_AUTO,
+    GZDEC_CORE_DEFLATE,
+};
+
+static uint32_t fuzz_next(uint32_t *state)
+{
+  *state = *state * 1103515245 + 12345;
+  return *state >> 16;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static uint8_t out[4096];
+  GzdecCore *core;
+  GzdecCoreStatus status = GZDEC_CORE_OK;
+  uint32_t state;
+  size_t pos, n, out_size, written;
+  uint64_t decoded = 0;
+
+  if (size < 2)
+    return 0;
+  core = gzdec_core_new(fuzz_formats[data[0] % 5], (GzdecCoreVerify)((data[0] >> 3) % 3));
+  if (core == NULL)
+    return 0;
+  gzdec_core_set_flush_points(core, data[0] & 0x80);
+  state = data[1];
+  data += 2;
+  size -= 2;
+
+  for (pos = 0; pos < size && status != GZDEC_CORE_ERROR; pos += n)
+  {
+    n = 1 + fuzz_next(&state) % 8192;
+    if (n > size - pos)
+      n = size - pos;
+    gzdec_core_feed(core, data + pos, n);
+    do
+    {
+      out_size = 1 + fuzz_next(&state) % sizeof(out);
+      status = gzdec_core_read(core, out, out_size, &written);
+      decoded += written;
+      gzdec_core_pop_header(core);
+    } while (status != GZDEC_CORE_ERROR && decoded < MAX_DECODED &&
+             (gzdec_core_input_left(core) > 0 || written == out_size));
+    if (decoded >= MAX_DECODED)
+      break;
+  }
+  gzdec_core_feed(core, NULL, 0);
+  gzdec_core_complete(core);
+  gzdec_core_get_crc(core);
+  gzdec_core_free(core);
+  return 0;
+}
+
+#ifndef GZDEC_LIBFUZZER
+int main(int argc, char **argv)
+{
+  uint8_t *data;
+  long size;
+  FILE *f;
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    if ((f = fopen(argv[i], "rb")) == NULL)
+    {
+      perror(argv[i]);
+      return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, f) != (size_t)size)
+    {
+      fprintf(stderr, "%s: read failed\n", argv[i]);
+      return 1;
+    }
+    fclose(f);
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+    printf("%s: ok\n", argv[i]);
+  }
+  return 0;
+}
+#endif